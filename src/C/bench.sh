@@ -0,0 +1,145 @@
+#!/bin/bash
+# Crude timing harness for ttm.exe.
+# Each case generates a program of increasing size into
+# ./bench.tmp and reports the elapsed time for each size;
+# time that grows linearly with size is the expected behavior.
+# Usage: bash ./bench.sh [case...]
+# Known cases: exec arith text scan args loop names class csv rp utf8
+
+TTM=./ttm.exe
+BENCHDIR=./bench.tmp
+SIZES=${SIZES:-"10000 100000 1000000"}
+CASES=${*:-"exec arith text scan args loop names class csv rp utf8"}
+
+TIMEFORMAT=%R
+
+# Program with many active calls embedded in plain text;
+# stresses the insertion of results into the active buffer.
+gen_exec() {
+    echo '#<ds;f;<x>>'
+    awk -v n=$1 'BEGIN{for(i=0;i<n;i++) printf("#<f> some ordinary text\n");}'
+}
+
+# Nested arithmetic; results are plain numbers that
+# need no rescan.
+gen_arith() {
+    awk -v n=$1 'BEGIN{for(i=0;i<n;i++) printf("#<ad;#<mu;%d;7>;#<su;%d;3>>\n",i,i);}'
+}
+
+# Mostly plain text, including bracketed text, with a few calls.
+gen_text() {
+    echo '#<ds;f;<x>>'
+    awk -v n=$1 'BEGIN{for(i=0;i<n;i++) {
+	printf("Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod\n");
+	printf("<tempor incididunt ut labore et dolore magna aliqua. Ut enim ad minim>\n");
+	if(i % 16 == 0) printf("#<f>\n");
+    }}'
+}
+
+# Dense with characters that scan() must look at one at a time:
+# escapes, sharps that are not calls, brackets.
+gen_scan() {
+    awk -v n=$1 'BEGIN{for(i=0;i<n;i++) {
+	printf("a@;b#c;d<e;@>f>g#h\n");
+	printf("#<eq?;a@;b#c;d<e;f>g#h;;>\n");
+    }}'
+}
+
+# Calls with many, longish arguments. The calls are put in the body
+# of a function so that reading the program file does not dominate.
+gen_args() {
+    awk -v n=$1 'BEGIN{
+	a = "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz";
+	printf("#<ds;f;<[a]>>#<ss;f;a>\n");
+	printf("#<ds;g;<");
+	for(i=0;i<100;i++) {
+	    printf("#<f");
+	    for(j=0;j<16;j++) printf(";%s",a);
+	    printf(">");
+	}
+	printf(">>\n");
+	for(i=0;i<n/100;i++) printf("#<g>\n");
+	}'
+}
+
+# A loop written as tail recursion; it must run in constant frame
+# depth and active buffer space without raising stacksize
+# (execcount is raised since each iteration makes three calls).
+# Use #<ttm;stats> to check the depth and buffer size.
+gen_loop() {
+    echo '#<setprop;execcount;1000000000>'
+    echo '#<ds;loop;<#<eq;N;0;;<#<loop;#<su;N;1>>>>>>#<ss;loop;N>'
+    echo "#<loop;$1>"
+}
+
+# Define n names, all with the same first character, then
+# look each of them up twice; stresses the dictionary.
+gen_names() {
+    echo '#<setprop;execcount;1000000000>'
+    awk -v n=$1 'BEGIN{
+	for(i=0;i<n;i++) printf("#<ds;n%d;>\n",i);
+	for(i=0;i<n;i++) printf("#<n%d>#<ndf;n%d;;>\n",(i*7919)%n,i);
+    }'
+}
+
+# Tokenize a long string into words and separators using
+# character classes; stresses #<scl> and #<tcl>.
+gen_class() {
+    echo '#<setprop;execcount;1000000000>'
+    echo '#<dcl;word;abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_>'
+    echo '#<dncl;nonword;abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_>'
+    awk -v n=$1 'BEGIN{
+	printf("#<ds;text;");
+	for(i=0;i<n/100;i++) printf("the_quick_brown_fox_jumps_over_the_lazy_dog_0123456789, αβγ. ");
+	printf(">\n");
+	}'
+    echo '#<ds;words;<#<eq?;#<tcl;word;text;y;n>;y;<#<scl;word;text>#<scl;nonword;text>#<words>>;>>>'
+    echo '#<words>'
+}
+
+# Split a long string of comma separated values into fields;
+# stresses #<scn> with the same delimiter on every call.
+gen_csv() {
+    echo '#<setprop;execcount;1000000000>'
+    awk -v n=$1 'BEGIN{
+	printf("#<ds;csv;");
+	for(i=0;i<n/50;i++) printf("id%d,some quoted text,3.14159,a somewhat longer field value %d\n",i,i);
+	printf("end>\n");
+	}'
+    echo '#<ds;fields;<#<eq?;#<scn;,;csv;EOF>;EOF;;<#<fields>>>>>'
+    echo '#<fields>'
+}
+
+# Walk a long non-ASCII string one character at a time, asking
+# for the residual pointer at each step; stresses the conversion
+# between codepoint and byte offsets (see buildcpindex).
+gen_rp() {
+    echo '#<setprop;execcount;1000000000>'
+    awk -v n=$1 'BEGIN{
+	printf("#<ds;text;");
+	for(i=0;i<n/10;i++) printf("αβγδ wxyz ");
+	printf(">\n");
+	}'
+    echo '#<ds;walk;<#<eq?;#<cn;1;text>;;;<#<srp;text;#<rp;text>>#<walk>>>>>'
+    echo '#<walk>'
+}
+
+# Plain non-ASCII text with no calls; mostly measures reading
+# and validating the program file (see readfile).
+gen_utf8() {
+    awk -v n=$1 'BEGIN{for(i=0;i<n;i++) {
+	printf("Lorem ipsum αβγδ εζηθ 中文文本 dolor sit amet, consectetur\n");
+	printf("plain ascii line with some words in it, then 🐕 and more\n");
+    }}'
+}
+
+mkdir -p ${BENCHDIR}
+for c in ${CASES} ; do
+    for n in ${SIZES} ; do
+	F=${BENCHDIR}/$c.$n.ttm
+	gen_$c $n > $F
+	printf "%s\t%s\t" $c $n
+	{ time ${TTM} -p $F -f /dev/null < /dev/null > /dev/null 2>&1 ; } 2>&1
+    done
+done
+rm -fr ${BENCHDIR}
@@ -10,9 +10,10 @@ struct Builtin;
 #define TTMFCN_END(ttm,frame,vsresult)
 
 /* Forward */
-static void defineBuiltinFunction1(TTM* ttm, struct Builtin* bin);
+static void defineBuiltinFunction1(TTM* ttm, const struct Builtin* bin);
 static void defineBuiltinFunctions(TTM* ttm);
 static char* trim(const char* s0, const char* ws);
+static void setString(Function* str, const char* body, size_t len);
 
 /* Dictionary Operations */
 static TTMERR
@@ -32,10 +33,11 @@ ttm_ap(TTM* ttm, Frame* frame, VString* result) /* Append to a string */
     }
     if(str->fcn.builtin) EXIT(TTM_ENOPRIM);
     apstring = frame->argv[2];
-    aplen = strlen((const char*)apstring);
+    aplen = frame->arglen[2];
     body = str->fcn.body;
     vsappendn(body,(const char*)apstring,aplen);
     vsindexset(body,vslength(body));
+    invalidatesegments(str);
 done:
     TTMFCN_END(ttm,frame,result);
     return THROW(err);
@@ -55,22 +57,24 @@ ttm_cf(TTM* ttm, Frame* frame, VString* result) /* Copy a function */
     char* oldname = frame->argv[2];
     Function* newfcn = dictionaryLookup(ttm,newname);
     Function* oldfcn = dictionaryLookup(ttm,oldname);
-    struct HashEntry saveentry;
 
     TTMFCN_BEGIN(ttm,frame,result);
     if(oldfcn == NULL) {err = FAILNONAMES(oldname); goto done;}
+    if(newfcn == oldfcn) goto done; /* copying a function onto itself is a no-op */
     if(newfcn == NULL) {
 	/* create a new string object with given name */
 	newfcn = newFunction(ttm,newname);
 	dictionaryInsert(ttm,newfcn);
     }
-    saveentry = newfcn->entry;
-    *newfcn = *oldfcn;
-    /* Keep new hash entry */
-    newfcn->entry = saveentry;
-    /* Do pointer fixup */
+    invalidatesegments(newfcn);
+    if(newfcn->fcn.body != NULL) vsfree(newfcn->fcn.body); /* the body being replaced */
+    /* Keep new hash entry (and local chain) */
+    newfcn->fcn = oldfcn->fcn;
+    /* Do pointer fixup; the body text is shared until either copy is modified */
     if(newfcn->fcn.body != NULL)
-	newfcn->fcn.body = vsclone(newfcn->fcn.body);
+	newfcn->fcn.body = vsshare(newfcn->fcn.body);
+    newfcn->fcn.segments = NULL; /* rebuilt on demand */
+    newfcn->fcn.cpindex = NULL;
 done:
     TTMFCN_END(ttm,frame,result);
     return THROW(err);
@@ -92,17 +96,77 @@ ttm_ds(TTM* ttm, Frame* frame, VString* result)
 	str = newFunction(ttm,frame->argv[1]);
 	dictionaryInsert(ttm,str);
     }
+    setString(str,frame->argv[2],frame->arglen[2]);
+done:
+    TTMFCN_END(ttm,frame,result);
+    return THROW(err);
+}
+
+/**
+Define a string that is local to the call whose arguments
+are being collected; it shadows any other definition of
+the name until that call completes, and is then freed.
+With no enclosing call, this is the same as #<ds>.
+*/
+static TTMERR
+ttm_dl(TTM* ttm, Frame* frame, VString* result) /* Define a local string */
+{
+    TTMERR err = TTM_NOERR;
+    TTMFCN_DECLS(ttm,frame);
+    Frame* scope = NULL;
+    Function* str = NULL;
+    unsigned hash;
+
+    TTMFCN_BEGIN(ttm,frame,result);
+    if(ttm->frames.top < 1) {err = ttm_ds(ttm,frame,result); goto done;}
+    /* As with #<ds>, a locked name (e.g. a builtin) cannot be shadowed */
+    str = dictionaryLookup(ttm,frame->argv[1]);
+    if(str != NULL && str->fcn.locked) EXIT(TTM_ELOCKED);
+    scope = ttm->frames.stack[ttm->frames.top-1];
+    hash = computehash(frame->argv[1]);
+    for(str=scope->locals;str != NULL;str=str->nextlocal) {
+	if(str->entry.hash == hash && strcmp(str->entry.name,frame->argv[1])==0) break;
+    }
+    if(str != NULL) { /* clean for re-use */
+	resetFunction(ttm,str);
+    } else {
+	str = newFunction(ttm,frame->argv[1]);
+	localInsert(ttm,scope,str);
+    }
+    setString(str,frame->argv[2],frame->arglen[2]);
+done:
+    TTMFCN_END(ttm,frame,result);
+    return THROW(err);
+}
+
+/**
+Return the argument; this is just a call to which
+names can be made local by #<dl>.
+*/
+static TTMERR
+ttm_scope(TTM* ttm, Frame* frame, VString* result) /* Delimit local names */
+{
+    TTMERR err = TTM_NOERR;
+    TTMFCN_DECLS(ttm,frame);
+    TTMFCN_BEGIN(ttm,frame,result);
+    if(frame->argc > 1)
+	vsappendn(result,(const char*)frame->argv[1],frame->arglen[1]);
+    TTMFCN_END(ttm,frame,result);
+    return THROW(err);
+}
+
+/* Make a (reset) function into a string with the given body */
+static void
+setString(Function* str, const char* body, size_t len)
+{
     str->fcn.trace = TR_UNDEF; /* default */
     str->fcn.builtin = 0;
     str->fcn.maxargs = ARB;
     str->fcn.sv = SV_SV;
     str->fcn.novalue = 0;
     str->fcn.body = vsnew();
-    vsappendn(str->fcn.body,(const char*)frame->argv[2],0);
+    vsappendn(str->fcn.body,body,len);
     vsindexset(str->fcn.body,0);
-done:
-    TTMFCN_END(ttm,frame,result);
-    return THROW(err);
 }
 
 static TTMERR
@@ -129,52 +193,181 @@ ttm_es(TTM* ttm, Frame* frame, VString* result) /* Erase string */
     return THROW(err);
 }
 
+static TTMERR
+ttm_esp(TTM* ttm, Frame* frame, VString* result) /* Erase strings by prefix */
+{
+    TTMERR err = TTM_NOERR;
+    TTMFCN_DECLS(ttm,frame);
+    size_t i;
+    TTMFCN_BEGIN(ttm,frame,result);
+    for(i=1;i<frame->argc;i++) {
+	const char* prefix = frame->argv[i];
+	size_t prefixlen = frame->arglen[i];
+	struct SkipNode* node = NULL;
+	if(prefixlen==0) continue; /* ignore empty prefixes */
+	/* Only the names with the prefix are visited */
+	node = hashFirst(&ttm->tables.dictionary,prefix);
+	while(node != NULL && strncmp(node->entry->name,prefix,prefixlen)==0) {
+	    Function* str = (Function*)node->entry;
+	    node = node->next[0]; /* before str is removed from the index */
+	    if(str->fcn.locked) err = TTM_ELOCKED; /* remember but keep going */
+	    else { /* str itself, not a local that shadows it */
+		globalRemove(ttm,str);
+		freeFunction(ttm,str); /* reclaim the string */
+	    }
+	}
+    }
+    TTMFCN_END(ttm,frame,result);
+    return THROW(err);
+}
+
+/* A match found by ttm_subst: body[start..start+len) is to become a mark */
+struct SubstMatch {
+    size_t start;
+    size_t len;
+    size_t segindex;
+};
+
+/**
+Find the first occurrence of pat in text[0..tlen) using Horspool's
+algorithm; the text need not be nul terminated.
+@param text to search
+@param tlen length of text in bytes
+@param pat pattern
+@param plen length of pat; > 0
+@param skip Horspool shift table for pat; see substskip
+@return offset of the match, or tlen if none
+*/
+static size_t
+substsearch(const char* text, size_t tlen, const char* pat, size_t plen, const size_t* skip)
+{
+    const utf8* t = UTF8P(text);
+    const utf8* p = UTF8P(pat);
+    size_t i = 0, last = plen - 1;
+
+    if(plen == 1) {
+	const char* q = (const char*)memchr(text,*pat,tlen);
+	return (q == NULL ? tlen : (size_t)(q - text));
+    }
+    while(i + plen <= tlen) {
+	utf8 c = t[i+last];
+	if(c == p[last] && memcmp(t+i,p,last) == 0) return i;
+	i += skip[c];
+    }
+    return tlen;
+}
+
+/* Build the Horspool shift table for pat */
+static void
+substskip(const char* pat, size_t plen, size_t* skip)
+{
+    size_t i;
+    for(i=0;i<256;i++) skip[i] = plen;
+    for(i=0;i + 1 < plen;i++) skip[UTF8(pat[i])] = plen - 1 - i;
+}
+
+/**
+Replace the matches in the body by their marks, building the
+new body in ttm->vs.tmp and copying it back.
+@param ttm
+@param text the body
+@param matches sorted by start and disjoint
+@return void
+*/
+static void
+substrebuild(TTM* ttm, VString* text, VArray* matches)
+{
+    const struct SubstMatch* m = (const struct SubstMatch*)vacontents(matches);
+    size_t i, n = valength(matches);
+    size_t rp = vsindex(text);
+    size_t from = 0;
+
+    vsclear(ttm->vs.tmp);
+    for(i=0;i<n;i++) {
+	utf8cpa segmark = empty_u8cpa;
+	segmark2utf8(segmark,m[i].segindex);
+	if(m[i].start > from) /* vsappendn takes 0 to mean strlen */
+	    vsappendn(ttm->vs.tmp,vscontents(text)+from,m[i].start - from);
+	vsappendn(ttm->vs.tmp,segmark,(size_t)u8size(segmark));
+	from = m[i].start + m[i].len;
+    }
+    if(vslength(text) > from)
+	vsappendn(ttm->vs.tmp,vscontents(text)+from,vslength(text) - from);
+    vsclear(text);
+    vsappendn(text,vscontents(ttm->vs.tmp),vslength(ttm->vs.tmp)); /* never empty */
+    vsindexset(text,rp); /* the residual precedes all the matches */
+    vsclear(ttm->vs.tmp);
+    vaclear(matches);
+}
+
 /**
 Helper function for #<sc> and #<ss> and #<cr>.
-For each copy of pattern, substitute the segmark or creation marks.
+For each copy of each pattern in the residual, substitute
+the segment or creation mark; patterns[i] gets mark segindex+i.
+The result is the same as replacing the copies of patterns[0]
+from left to right, then those of patterns[1], and so on.
+Since the text of a mark cannot be part of a copy of a later
+pattern, the copies of patterns[i] are just those found in the
+gaps between the copies of the earlier patterns. So the copies
+are collected, one pattern at a time, without changing the body,
+and the new body is built once at the end; the time is linear
+in the size of the body for each pattern, however many copies.
 @param ttm
 @param text to search
-@param pattern to replace
-@param segmark for substituting 
+@param patterns to replace
+@param npatterns no. of patterns
+@param segindex for substituting patterns[0]
 @param segcountp # of segment counters inserted.
 @return TTMERR
 */
 static TTMERR
-ttm_subst(TTM* ttm, VString* text, const char* pattern, size_t segindex, size_t* segcountp)
+ttm_subst(TTM* ttm, VString* text, char** patterns, size_t npatterns, size_t segindex, size_t* segcountp)
 {
     TTMERR err = TTM_NOERR;
-    size_t patlen;
     size_t segcount = 0;
-    utf8cpa segmark = empty_u8cpa;
-    int seglen;
-    size_t rp;
-    const char* body = NULL;
-
-    segmark2utf8(segmark,segindex);
-    seglen = u8size(segmark);	
+    size_t skip[256];
+    VArray* matches = vanew(sizeof(struct SubstMatch)); /* found so far; sorted */
+    VArray* merged = vanew(sizeof(struct SubstMatch));
+    size_t i;
 
-    patlen = strlen(pattern);
-    if(patlen == 0) goto done; /* no subst possible */
-    
-    body = vscontents(text);
-    rp = vsindex(text); /* save for restore */
-    for(;;) {
-	size_t pos = vsindex(text); /* search offset*/
-	const char* search = NULL; /* search ptr */
-	const char* q = NULL;
-	if(pos >= vslength(text)) goto done; /* EOS */
-	search = vsindexp(text);
-	q = strstr8(search,pattern);
-	if(q == NULL) break; /* search finished */
-	/* q points to next matching string */
-	pos = (size_t)(q - body); /* compute new pos of the matching string */
-	vsindexset(text,pos); /* set the rp to the new pos */
-	vaindexremoven(text,patlen); /* remove pattern */
-	vaindexinsertn(text,segmark,seglen); /* insert segmark; will update index */
-	segcount++;
-    }	
-done:
-    vsindexset(text,rp); /* restore */
+    for(i=0;i<npatterns;i++) {
+	const char* pat = patterns[i];
+	size_t plen = strlen(pat);
+	size_t k, nold, from;
+	if(plen == 0) continue; /* no subst possible */
+	/* A pattern that could match across a mark must see the marks;
+	   this needs a SEGMARK0 or a pattern that is not valid UTF-8 */
+	if(valength(matches) > 0 && (strchr(pat,SEGMARK0) != NULL || (UTF8(pat[0]) & 0xC0) == 0x80))
+	    substrebuild(ttm,text,matches);
+	substskip(pat,plen,skip);
+	/* Search the gaps between the earlier matches, merging as we go */
+	nold = valength(matches);
+	from = vsindex(text);
+	for(k=0;k<=nold;k++) {
+	    const struct SubstMatch* old = (k < nold ? (const struct SubstMatch*)vagetp(matches,k) : NULL);
+	    size_t gapend = (old != NULL ? old->start : vslength(text));
+	    while(from + plen <= gapend) {
+		struct SubstMatch m;
+		size_t off = substsearch(vscontents(text)+from,gapend-from,pat,plen,skip);
+		if(off == gapend - from) break;
+		m.start = from + off;
+		m.len = plen;
+		m.segindex = segindex + i;
+		vaappend(merged,&m);
+		segcount++;
+		from = m.start + plen;
+	    }
+	    if(old != NULL) {
+		vaappend(merged,old);
+		from = old->start + old->len;
+	    }
+	}
+	{VArray* tmp = matches; matches = merged; merged = tmp;}
+	vaclear(merged);
+    }
+    if(valength(matches) > 0) substrebuild(ttm,text,matches);
+    vafree(matches);
+    vafree(merged);
     if(segcountp) *segcountp = segcount;
     return THROW(err);
 }
@@ -186,8 +379,8 @@ ttm_sc(TTM* ttm, Frame* frame, VString* result) /* Segment and count */
     TTMERR err = TTM_NOERR;
     TTMFCN_DECLS(ttm,frame);
     Function* str = NULL;
-    size_t i, segindex;
-    size_t nsegs, segcount;
+    size_t segindex;
+    size_t segcount;
     VString* text = NULL;
     char count[64];
 
@@ -198,11 +391,8 @@ ttm_sc(TTM* ttm, Frame* frame, VString* result) /* Segment and count */
     text = str->fcn.body;
     segindex = SEGINDEXFIRST;
     segcount = 0;
-    for(i=2;i<frame->argc;i++,segindex++) {
-	nsegs = 0;
-	if((err=ttm_subst(ttm,text,frame->argv[i],segindex,&nsegs))) EXIT(err);
-	segcount += nsegs;
-    }
+    if((err=ttm_subst(ttm,text,frame->argv+2,frame->argc-2,segindex,&segcount))) EXIT(err);
+    invalidatesegments(str);
     snprintf(count,sizeof(count),"%zu",segcount);
     /* Insert into result */
     vsappendn(result,(const char*)count,strlen(count));
@@ -217,7 +407,7 @@ ttm_ss(TTM* ttm, Frame* frame, VString* result) /* Segment and count */
     TTMERR err = TTM_NOERR;
     TTMFCN_DECLS(ttm,frame);
     Function* str = NULL;
-    size_t i, segindex;
+    size_t segindex;
     VString* text = NULL;
 
     TTMFCN_BEGIN(ttm,frame,result);
@@ -226,9 +416,8 @@ ttm_ss(TTM* ttm, Frame* frame, VString* result) /* Segment and count */
     if(str->fcn.locked) EXIT(TTM_ELOCKED);
     text = str->fcn.body;
     segindex = SEGINDEXFIRST;
-    for(i=2;i<frame->argc;i++,segindex++) {
-	if((err=ttm_subst(ttm,text,frame->argv[i],segindex,NULL))) EXIT(err);
-    }
+    if((err=ttm_subst(ttm,text,frame->argv+2,frame->argc-2,segindex,NULL))) EXIT(err);
+    invalidatesegments(str);
 done:
     TTMFCN_END(ttm,frame,result);
     return THROW(err);
@@ -247,7 +436,8 @@ ttm_cr(TTM* ttm, Frame* frame, VString* result) /* Mark for creation */
     if(str->fcn.builtin) EXIT(TTM_ENOPRIM);
     if(str->fcn.locked) EXIT(TTM_ELOCKED);
     text = str->fcn.body;
-    err = ttm_subst(ttm,text,frame->argv[2],CREATEINDEXONLY,NULL);
+    err = ttm_subst(ttm,text,frame->argv+2,1,CREATEINDEXONLY,NULL);
+    invalidatesegments(str);
 done:
     TTMFCN_END(ttm,frame,result);
     return THROW(err);
@@ -284,8 +474,7 @@ ttm_cn(TTM* ttm, Frame* frame, VString* result) /* Call n characters (codepoints
     TTMFCN_DECLS(ttm,frame);
     Function* fcn;
     long long ln;
-    int n;
-    int ncp, nbytes;
+    size_t nbytes;
     const char* p = NULL;
 
     TTMFCN_BEGIN(ttm,frame,result);
@@ -296,18 +485,12 @@ ttm_cn(TTM* ttm, Frame* frame, VString* result) /* Call n characters (codepoints
     if(ln < 0) EXIT(TTM_ENOTNEGATIVE);
 
     vsclear(result);
-    n = (int)ln;
     p = vsindexp(fcn->fcn.body);
-    nbytes = (int)strlen((const char*)p);
-    if(n == 0 || nbytes == 0) goto done;
     /* copy up to n codepoints or EOS encountered */
-    while(n-- > 0) {
-	p = vsindexp(fcn->fcn.body);
-        if(isnul(p)) break; /* EOS */
-	if((ncp = u8size(p))<=0) return TTM_EUTF8;
-	vsappendn(result,(const char*)p,ncp);
-	vsindexskip(fcn->fcn.body,ncp);
-    }
+    nbytes = u8skip(p,vslength(fcn->fcn.body) - vsindex(fcn->fcn.body),(size_t)ln);
+    if(nbytes == 0) goto done;
+    vsappendn(result,p,nbytes);
+    vsindexskip(fcn->fcn.body,nbytes);
 
 done:
     TTMFCN_END(ttm,frame,result);
@@ -357,16 +540,15 @@ ttm_isc(TTM* ttm, Frame* frame, VString* vsresult) /* Initial character scan; mo
     str = getdictstr(ttm,frame,2);
 
     arg = frame->argv[1];
-    arglen = strlen((const char*)arg);
+    arglen = frame->arglen[1];
     t = frame->argv[3];
     f = frame->argv[4];
 
-    /* check for initial string match */
-    if(strncmp(vsindexp(str->fcn.body),(const char*)arg,arglen)==0) {
+    /* check for initial string match; memcmp is vectorized by the C library */
+    slen = vslength(str->fcn.body) - vsindex(str->fcn.body);
+    if(arglen <= slen && memcmp(vsindexp(str->fcn.body),arg,arglen)==0) {
 	value = t;
 	vsindexskip(str->fcn.body,arglen);
-	slen = vslength(str->fcn.body);
-	if(vsindex(str->fcn.body) > slen) vsindexset(str->fcn.body,slen);
     } else
 	value = f;
     vsclear(vsresult);
@@ -391,12 +573,12 @@ ttm_scn(TTM* ttm, Frame* frame, VString* result) /* Character scan */
     str = getdictstr(ttm,frame,2);
 
     arg = frame->argv[1];
-    arglen = strlen((const char*)arg);
+    arglen = frame->arglen[1];
     f = frame->argv[3];
 
-    /* check for sub string match */
+    /* check for sub string match; scanning loops use the same few patterns */
     p0 = vsindexp(str->fcn.body);
-    p = strstr(p0,arg);
+    p = (char*)searchfind(searcherLookup(ttm,arg,arglen),p0,vslength(str->fcn.body)-vsindex(str->fcn.body));
     vsclear(result);
     if(p == NULL) {/* no match; return argv[3] */
 	vsappendn(result,(const char*)f,strlen((const char*)f));
@@ -534,21 +716,19 @@ ttm_gn(TTM* ttm, Frame* frame, VString* result) /* Give n characters from argume
     TTMFCN_DECLS(ttm,frame);
     char* snum = frame->argv[1];
     char* s = frame->argv[2];
+    size_t len = frame->arglen[2];
     long long num;
-    int nbytes = 0;
+    size_t nbytes = 0;
 
     TTMFCN_BEGIN(ttm,frame,result);
     if(1 != sscanf((const char*)snum,"%lld",&num)) EXIT(TTM_EDECIMAL);
+    if(num != 0 && len == 0) EXIT(TTM_EUTF8); /* historical: an empty string is an error */
     if(num > 0) {
-	nbytes = u8ith(s,(int)num);
-	if(nbytes <= 0) EXIT(TTM_EUTF8);
-	vsappendn(result,(const char*)s,(size_t)nbytes);
+	nbytes = u8skip(s,len,(size_t)num);
+	if(nbytes > 0) vsappendn(result,(const char*)s,nbytes);
     } else if(num < 0) {
-	num = -num;
-	nbytes = u8ith(s,(int)num);
-	if(nbytes <= 0) EXIT(TTM_EUTF8);
-	s += nbytes;
-	vsappendn(result,(const char*)s,strlen((const char*)s));
+	nbytes = u8skip(s,len,(size_t)-num);
+	if(nbytes < len) vsappendn(result,(const char*)s+nbytes,len - nbytes);
     }
 done:
     TTMFCN_END(ttm,frame,result);
@@ -745,7 +925,7 @@ ttm_dcl0(TTM* ttm, Frame* frame, int negative, VString* result)
 {
     TTMERR err = TTM_NOERR;
     Charclass* cl = NULL;
-    if(strlen(frame->argv[1])==0) EXIT(TTM_ENOCLASS);
+    if(frame->arglen[1]==0) EXIT(TTM_ENOCLASS);
     cl = charclassLookup(ttm,frame->argv[1]);
     if(cl == NULL) {
 	/* create a new charclass object */
@@ -755,6 +935,7 @@ ttm_dcl0(TTM* ttm, Frame* frame, int negative, VString* result)
     nullfree(cl->characters);
     cl->characters = strdup((const char*)frame->argv[2]);
     cl->negative = negative;
+    compilecharclass(ttm,cl);
 done:
     return THROW(err);
 }
@@ -809,7 +990,6 @@ ttm_ccl(TTM* ttm, Frame* frame, VString* result) /* call class */
     TTMFCN_DECLS(ttm,frame);
     Charclass* cl = NULL;
     Function* str = NULL;
-    const char* clseq = NULL;
     const char* cp8 = NULL;
     const char* match = NULL;
     size_t rr0,delta;
@@ -818,13 +998,12 @@ ttm_ccl(TTM* ttm, Frame* frame, VString* result) /* call class */
     if((str = getdictstr(ttm,frame,2))==NULL) {err = FAILNONAME(2); goto done;}
     if((cl = charclassLookup(ttm,frame->argv[1]))==NULL) FAILNOCLASS(1);
 
-    clseq = cl->characters;
     cp8 = vsindexp(str->fcn.body);
 
     /* Starting at vsindex(str->fcn.body), locate first char not in class (or negative) */
     vsclear(result);
     rr0 = vsindex(str->fcn.body);
-    match = charclassmatch(cp8,clseq,cl->negative);
+    match = charclassmatch(cl,cp8,vslength(str->fcn.body)-rr0);
     delta = (size_t)(match - cp8);
     vsindexset(str->fcn.body,rr0); /* temporary */
     vsappendn(result,vsindexp(str->fcn.body),delta);
@@ -841,7 +1020,6 @@ ttm_scl(TTM* ttm, Frame* frame, VString* result) /* skip class */
     TTMFCN_DECLS(ttm,frame);
     Charclass* cl = NULL;
     Function* str = NULL;
-    const char* clseq = NULL;
     const char* cp8 = NULL;
     const char* match = NULL;
     size_t rr0, delta;
@@ -851,10 +1029,9 @@ ttm_scl(TTM* ttm, Frame* frame, VString* result) /* skip class */
     if((cl = charclassLookup(ttm,frame->argv[1]))==NULL) FAILNOCLASS(1);
 
     vsclear(result);
-    clseq = cl->characters;
     cp8 = vsindexp(str->fcn.body);
     rr0 = vsindex(str->fcn.body);
-    match = charclassmatch(cp8,clseq,cl->negative);
+    match = charclassmatch(cl,cp8,vslength(str->fcn.body)-rr0);
     delta = (size_t)(match - cp8);
     vsindexset(str->fcn.body,rr0+delta); /* final residual index */
 
@@ -873,14 +1050,13 @@ ttm_tcl(TTM* ttm, Frame* frame, VString* result) /* Test class */
     const char* retval;
     const char* t = NULL;
     const char* f = NULL;
-    const char* clseq = NULL;
     const char* cp8 = NULL;
     const char* match = NULL;
 
     TTMFCN_BEGIN(ttm,frame,result);
     if((cl = charclassLookup(ttm,frame->argv[1]))==NULL) FAILNOCLASS(1);
 
-    if(strlen(frame->argv[2]) > 0) {
+    if(frame->arglen[2] > 0) {
 	if((str = getdictstr(ttm,frame,2))==NULL) {err = FAILNONAME(2); goto done;}
     } else
         str = NULL;
@@ -891,10 +1067,11 @@ ttm_tcl(TTM* ttm, Frame* frame, VString* result) /* Test class */
     if(str == NULL)
 	retval = f;
     else {
-        clseq = cl->characters;
+        size_t len = vslength(str->fcn.body) - vsindex(str->fcn.body);
         cp8 = vsindexp(str->fcn.body);
-        /* Starting at vsindex(str->fcn.body), locate first char not in class (or negative) */
-        match = charclassmatch(cp8,clseq,cl->negative);
+        /* Only the first char of the residual needs to be tested */
+        if(len > 0 && u8size(cp8) > 0 && len > (size_t)u8size(cp8)) len = (size_t)u8size(cp8);
+        match = charclassmatch(cl,cp8,len);
 	if(match == cp8) retval = f; else retval = t;
     }
     vsappendn(result,(const char*)retval,strlen((const char*)retval));
@@ -1402,6 +1579,7 @@ ttm_cm(TTM* ttm, Frame* frame, VString* result) /* Change meta character and ret
     if(u8size(replacement) <= 0) EXIT(TTM_EUTF8);
     memcpycp(prev,ttm->meta.metac);
     if(strlen(replacement) > 0) memcpycp(ttm->meta.metac,replacement);
+    buildsigtable(ttm);
     vsappendn(result,prev,u8size(prev));
 done:
     TTMFCN_END(ttm,frame,result);
@@ -1726,14 +1904,12 @@ ttm_rp(TTM* ttm, Frame* frame, VString* result) /* return residual pointer*/
     TTMERR err = TTM_NOERR;
     TTMFCN_DECLS(ttm,frame);
     Function* str;
-    char* s;
     size_t rp = 0;
     char srp[128];
     
     TTMFCN_BEGIN(ttm,frame,result);
     if((str = getdictstr(ttm,frame,1))==NULL) {err = FAILNONAME(1); goto done;}
-    s = vscontents(str->fcn.body);
-    switch(err = strsubcp(s,vsindex(str->fcn.body),&rp)) {
+    switch(err = bodyrptocp(ttm,str,vsindex(str->fcn.body),&rp)) {
     case TTM_NOERR: case TTM_EEOS: break;
     default: goto done;
     }
@@ -1765,7 +1941,7 @@ ttm_srp(TTM* ttm, Frame* frame, VString* result) /* set residual pointer*/
     }
     if((str = getdictstr(ttm,frame,1))==NULL) {err = FAILNONAME(1); goto done;}
     /* convert from codepoint offset to byte offset */
-    srp = cptorp(ttm,vscontents(str->fcn.body)+srp,srp);
+    srp = bodycptorp(ttm,str,srp);
     vsindexset(str->fcn.body,srp);
 
 done:
@@ -1789,6 +1965,19 @@ fcncmp(const void* a, const void* b)
     return strcmp((const char*)(*fa)->entry.name,(const char*)(*fb)->entry.name);
 }
 
+/* Append one #<names> result entry: the name and optional body */
+static void
+namesappend(VString* result, Function* f, int withbody, int first)
+{
+    if(!first) vsappend(result,',');
+    vsappendn(result,(const char*)f->entry.name,strlen(f->entry.name));
+    if(!f->fcn.builtin && withbody) {
+	vsappendn(result,"=|",2);
+	vsappendn(result,vscontents(f->fcn.body),vslength(f->fcn.body));
+	vsappendn(result,"|",1);	
+    }
+}
+
 static TTMERR
 ttm_names(TTM* ttm, Frame* frame, VString* result) /* Obtain all dictionary instance names in sorted order */
 {
@@ -1796,12 +1985,17 @@ ttm_names(TTM* ttm, Frame* frame, VString* result) /* Obtain all dictionary inst
     TTMFCN_DECLS(ttm,frame);
     size_t i;
     VList* nameset = vlnew();
+    struct SkipNode* node = NULL;
     const char* arg = NULL;
+    const char* prefix = NULL;
+    size_t prefixlen = 0;
     int klass = 0;
+    int first = 1;
 #	define TTM_NAMES_ALL	  (1<<0)
 #	define TTM_NAMES_STRINGS  (1<<1)
 #	define TTM_NAMES_BUILTIN  (1<<2)
 #	define TTM_NAMES_SPECIFIC (1<<3)
+#	define TTM_NAMES_PREFIX   (1<<4)
 #	    define TTM_NAMES_BODY (1<<16) /* => SPECIFIC|BODY*/
 
     TTMFCN_BEGIN(ttm,frame,result);
@@ -1809,64 +2003,65 @@ ttm_names(TTM* ttm, Frame* frame, VString* result) /* Obtain all dictionary inst
        * #<names> -- all names
        * #<names;strings[,body]>	-- all ##<ds;string> names with optional body
        * #<names;builtin>		-- all builtin names
+       * #<names;prefix;prefix>		-- all names starting with prefix
        * #<names;;...>			-- specific names; note the ';;' empty arg
        * #<names;body;...>		-- specific + body
     */
-    i = frame->argc;
-    switch (i) {
-    case 0: err = TTM_ETTM; goto done; /* should never happen */
-    case 1: klass = TTM_NAMES_ALL; break;
-    case 2:
-	arg = (const char*)frame->argv[i];
+    if(frame->argc == 0) EXIT(TTM_ETTM); /* should never happen */
+    if(frame->argc == 1)
+	klass = TTM_NAMES_ALL;
+    else {
+	arg = (const char*)frame->argv[1];
 	if(strcmp(arg,"strings")==0)
 	    klass = TTM_NAMES_STRINGS;
 	else if(strcmp(arg,"strings,body")==0)
 	    klass = TTM_NAMES_STRINGS | TTM_NAMES_BODY;
 	else if(strcmp(arg,"builtin")==0)
 	    klass = TTM_NAMES_BUILTIN;
-	else if(arg == NULL || strcmp(arg,"")==0)
+	else if(strcmp(arg,"prefix")==0) {
+	    if(frame->argc < 3) EXIT(TTM_EFEWPARMS);
+	    klass = TTM_NAMES_PREFIX;
+	    prefix = frame->argv[2];
+	    prefixlen = frame->arglen[2];
+	} else if(strcmp(arg,"")==0)
 	    klass = TTM_NAMES_SPECIFIC;
-	else if(arg == NULL || strcmp(arg,"body")==0)
+	else if(strcmp(arg,"body")==0)
 	    klass = TTM_NAMES_SPECIFIC | TTM_NAMES_BODY;
-	break;
-    default: klass = TTM_NAMES_SPECIFIC; break;
+	else if(frame->argc > 2)
+	    klass = TTM_NAMES_SPECIFIC;
     }
 
     if(klass == 0) EXIT(TTM_EFEWPARMS);
 
-    /* Collect all the relevant Functions. */
-    for(i=0;i<HASHSIZE;i++) {
-	struct Function* fcn = (struct Function*)ttm->tables.dictionary.table[i].next;
-	while(fcn != NULL) {
-	    if((klass & TTM_NAMES_ALL)
-	       || ((klass & TTM_NAMES_STRINGS) && !fcn->fcn.builtin)
-	       || ((klass & TTM_NAMES_BUILTIN) && fcn->fcn.builtin)) {
-		vlpush(nameset,fcn);
-	    } else if((klass & TTM_NAMES_SPECIFIC)) {
-		size_t j;
-		for(j=2;j<frame->argc;j++) {
-		    if(strcmp((const char*)frame->argv[j],(const char*)fcn->entry.name)==0)
-			{vlpush(nameset,fcn); break;}
-		}
-	    }
-	    fcn = (struct Function*)fcn->entry.next;
+    if(klass & TTM_NAMES_SPECIFIC) {
+	/* Look up each requested name, then sort the (few) found */
+	for(i=2;i<frame->argc;i++) {
+	    Function* fcn = dictionaryLookup(ttm,frame->argv[i]);
+	    if(fcn != NULL) vlpush(nameset,fcn);
+	}
+	{
+	    void* content = vlcontents(nameset);
+	    qsort(content, vllength(nameset), sizeof(struct Function*), fcncmp);
 	}
+	for(i=0;i<vllength(nameset);i++) {
+	    Function* f = (Function*)vlget(nameset,i);
+	    if(i > 0 && f == (Function*)vlget(nameset,i-1)) continue; /* repeated name */
+	    namesappend(result,f,(klass & TTM_NAMES_BODY),first);
+	    first = 0;
+	}
+	goto done;
     }
-    /* Quick sort the list */
-    {
-        void* content = vlcontents(nameset);
-	qsort(content, vllength(nameset), sizeof(struct Function*), fcncmp);
-    }
-    /* print names comma separated and optional body */
-    for(i=0;i<vllength(nameset);i++) {
-	Function* f =  (Function*)vlget(nameset,i);
-	const char* nm = f->entry.name;
-	if(i > 0) vsappend(result,',');
-	vsappendn(result,(const char*)nm,0);
-	if(!f->fcn.builtin && (klass & TTM_NAMES_BODY)==TTM_NAMES_BODY) {
-	    vsappendn(result,"=|",2);
-	    vsappendn(result,vscontents(f->fcn.body),vslength(f->fcn.body));
-	    vsappendn(result,"|",1);	
+
+    /* The ordered index yields the names already sorted */
+    for(node=hashFirst(&ttm->tables.dictionary,prefix);node != NULL;node=node->next[0]) {
+	Function* fcn = (Function*)node->entry;
+	if(prefix != NULL && strncmp(fcn->entry.name,prefix,prefixlen) != 0)
+	    break; /* past the names with this prefix */
+	if((klass & (TTM_NAMES_ALL|TTM_NAMES_PREFIX))
+	   || ((klass & TTM_NAMES_STRINGS) && !fcn->fcn.builtin)
+	   || ((klass & TTM_NAMES_BUILTIN) && fcn->fcn.builtin)) {
+	    namesappend(result,fcn,(klass & TTM_NAMES_BODY),first);
+	    first = 0;
 	}
     }
 done:
@@ -1924,11 +2119,14 @@ ttm_norm(TTM* ttm, Frame* frame, VString* result) /* Obtain the Norm of a string
     TTMFCN_DECLS(ttm,frame);
     char* s;
     char value[32];
-    size_t count;
+    size_t count = 0, len;
 
     TTMFCN_BEGIN(ttm,frame,result);
     s = frame->argv[1];
-    switch (err = strsubcp(s,strlen((const char*)s),&count)) {
+    len = frame->arglen[1];
+    if(u8validspan(s,len) == len)
+	count = u8count(s,len);
+    else switch (err = strsubcp(s,len,&count)) { /* report the error as before */
     case TTM_NOERR: case TTM_EEOS: break;
     default: goto done;
     }
@@ -2194,37 +2392,16 @@ ttm_classes(TTM* ttm, Frame* frame, VString* result) /* Obtain all character cla
 {
     TTMERR err = TTM_NOERR;
     TTMFCN_DECLS(ttm,frame);
-    size_t i;
-    VList* classes = NULL;
-    char** contents = NULL;
+    struct SkipNode* node = NULL;
+    int first;
 
     TTMFCN_BEGIN(ttm,frame,result);
-
-    /* Now collect all the classes */
-    /* Note the reason we collect the classes is because we need to sort them */
-    classes = vlnew();
-    if(classes == NULL) EXIT(TTM_EMEMORY);
-    for(i=0;i<HASHSIZE;i++) {
-	struct HashEntry* entry = ttm->tables.charclasses.table[i].next;
-	while(entry != NULL) {
-	    Charclass* class = (Charclass*)entry;
-	    vlpush(classes,class->entry.name);
-	    entry = entry->next;
-	}
-    }
-    /* Quick sort */
-    contents = (char**)vlcontents(classes);
-    qsort((void*)contents, vllength(classes), sizeof(char*), stringveccmp);
-
-    /* print classes comma separated */
-    for(i=0;i<vllength(classes);i++) {
-	const char* nm = (const char*)vlget(classes,i);
-	if(i > 0) vsappend(result,',');
+    /* print classes comma separated; the ordered index yields them sorted */
+    for(first=1,node=hashFirst(&ttm->tables.charclasses,NULL);node != NULL;first=0,node=node->next[0]) {
+	const char* nm = (const char*)node->entry->name;
+	if(!first) vsappend(result,',');
 	vsappendn(result,nm,strlen(nm));
     }
-
-done:
-    vlfree(classes);
     TTMFCN_END(ttm,frame,result);
     return THROW(err);
 }
@@ -2239,15 +2416,14 @@ ttm_lf(TTM* ttm, Frame* frame, VString* result) /* Lock a list of function from
 
     TTMFCN_BEGIN(ttm,frame,result);
     if(frame->argc > 1) {/*lock specific names; a single null name => lock all functions */
-	if(frame->argc == 2 && strlen((const char*)frame->argv[1])==0) {
-	    for(i=0;i<HASHSIZE;i++) {
-		struct HashEntry* entry = ttm->tables.dictionary.table[i].next;
-		while(entry != NULL) {
-		    fcn = (Function*)entry;
-		    if(!fcn->fcn.builtin) fcn->fcn.locked = 1;
-		    entry = entry->next;
-		}
+	if(frame->argc == 2 && frame->arglen[1]==0) {
+	    void* walker = hashwalk(&ttm->tables.dictionary);
+	    struct HashEntry* entry = NULL;
+	    while(hashnext(walker,&entry)) {
+		fcn = (Function*)entry;
+		if(!fcn->fcn.builtin) fcn->fcn.locked = 1;
 	    }
+	    hashwalkstop(walker);
 	} else for(i=1;i<frame->argc;i++) {
 	    fcn = dictionaryLookup(ttm,frame->argv[i]);
 	    if(fcn != NULL && !fcn->fcn.builtin) fcn->fcn.locked = 1;
@@ -2267,15 +2443,14 @@ ttm_uf(TTM* ttm, Frame* frame, VString* result) /* Un-Lock a function from being
 
     TTMFCN_BEGIN(ttm,frame,result);
     if(frame->argc > 1) {/*lock specific names; a single null name => lock all functions */
-	if(frame->argc == 2 && strlen((const char*)frame->argv[1])==0) {
-	    for(i=0;i<HASHSIZE;i++) {
-		struct HashEntry* entry = ttm->tables.dictionary.table[i].next;
-		while(entry != NULL) {
-		    fcn = (Function*)entry;
-		    if(!fcn->fcn.builtin) fcn->fcn.locked = 0;
-		    entry = entry->next;
-		}
+	if(frame->argc == 2 && frame->arglen[1]==0) {
+	    void* walker = hashwalk(&ttm->tables.dictionary);
+	    struct HashEntry* entry = NULL;
+	    while(hashnext(walker,&entry)) {
+		fcn = (Function*)entry;
+		if(!fcn->fcn.builtin) fcn->fcn.locked = 0;
 	    }
+	    hashwalkstop(walker);
 	} else for(i=1;i<frame->argc;i++) {
 	    fcn = dictionaryLookup(ttm,frame->argv[i]);
 	    if(fcn != NULL && !fcn->fcn.builtin) fcn->fcn.locked = 0;
@@ -2377,16 +2552,17 @@ ttm_catch(TTM* ttm, Frame* frame, VString* result) /* evaluate ttm expression an
 {
     TTMERR err = TTM_NOERR;
     TTMFCN_DECLS(ttm,frame);
-    VString* active = NULL;
-    VString* passive = NULL;
+    struct Suspended saved;
 	
     TTMFCN_BEGIN(ttm,frame,result);
-    /* save relevant TTM fields  */
-    active = ttm->vs.active;
-    passive = ttm->vs.passive;
+    /* save relevant TTM fields; they stay visible to the collector (see gc.h) */
+    saved.active = ttm->vs.active;
+    saved.passive = ttm->vs.passive;
+    saved.next = ttm->vs.suspended;
+    ttm->vs.suspended = &saved;
     ttm->vs.active = vsnew();
     ttm->vs.passive = vsnew();
-    vsappendn(ttm->vs.active,frame->argv[1],strlen(frame->argv[1]));
+    vsappendn(ttm->vs.active,frame->argv[1],frame->arglen[1]);
     vsindexset(ttm->vs.active,0);
     ttm->flags.catchdepth++;
     err = scan(ttm);
@@ -2406,9 +2582,10 @@ ttm_catch(TTM* ttm, Frame* frame, VString* result) /* evaluate ttm expression an
 /*done:*/
     /* Reset */
     vsfree(ttm->vs.active);
-    ttm->vs.active = active;
+    ttm->vs.active = saved.active;
     vsfree(ttm->vs.passive);
-    ttm->vs.passive = passive;
+    ttm->vs.passive = saved.passive;
+    ttm->vs.suspended = saved.next;
     TTMFCN_END(ttm,frame,result);
     return THROW(err);
 }
@@ -2431,10 +2608,11 @@ ttm_switch(TTM* ttm, Frame* frame, VString* result) /* return current global tra
 
     TTMFCN_BEGIN(ttm,frame,result);
     if(frame->argc < 3) EXIT(TTM_EFEWPARMS);
+    odd = ((frame->argc - 3) % 2) == 1;
+    if(odd) /* supply the missing value; this may move the arguments */
+	pushArgv(ttm,frame,"",0);
     test = trim(frame->argv[1],WHITESPACE);
     _default = frame->argv[2];
-    odd = ((frame->argc - 3) % 2) == 1;
-    if(odd) {frame->argv[frame->argc] = strdup(""); frame->argc++;}
     for(pair=3;pair<frame->argc;pair+=2) {
 	char* trkey = trim(frame->argv[pair],WHITESPACE);
 	if(strcmp(trkey,test)==0) {
@@ -2472,7 +2650,7 @@ ttm_include(TTM* ttm, Frame* frame, VString* result)  /* Include text of a file
     char* baseseg = NULL;
 
     TTMFCN_BEGIN(ttm,frame,result);
-    if(strlen(frame->argv[1])==0) EXIT(TTM_EINCLUDE);
+    if(frame->arglen[1]==0) EXIT(TTM_EINCLUDE);
     path = strdup(frame->argv[1]);
 
     if(ttm->opts.testing) {
@@ -2657,11 +2835,13 @@ ttm_removeprop(TTM* ttm, Frame* frame, VString* result) /* remove specified prop
     TTMERR err = TTM_NOERR;
     TTMFCN_DECLS(ttm,frame);
     char* key = NULL;
+    Property* prop = NULL;
     
     TTMFCN_BEGIN(ttm,frame,result);
     if(frame->argc < 1) EXIT(TTM_EFEWPARMS);
     key = frame->argv[1];
-    (void)propertyRemove(ttm,key);
+    prop = propertyRemove(ttm,key);
+    if(prop != NULL) freeProperty(ttm,prop); /* return it to the pool */
 done:
     TTMFCN_END(ttm,frame,result);
     return THROW(err);
@@ -2672,37 +2852,16 @@ ttm_properties(TTM* ttm, Frame* frame, VString* result) /* Obtain all property n
 {
     TTMERR err = TTM_NOERR;
     TTMFCN_DECLS(ttm,frame);
-    size_t i;
-    VList* props = NULL;
-    char** contents = NULL;
+    struct SkipNode* node = NULL;
+    int first;
 
     TTMFCN_BEGIN(ttm,frame,result);
-
-    /* Now collect all the properties */
-    /* Note the reason we collect them is because we need to sort them */
-    props = vlnew();
-    if(props == NULL) EXIT(TTM_EMEMORY);
-    for(i=0;i<HASHSIZE;i++) {
-	struct HashEntry* entry = ttm->tables.properties.table[i].next;
-	while(entry != NULL) {
-	    Property* prop = (Property*)entry;
-	    vlpush(props,prop->entry.name);
-	    entry = entry->next;
-	}
-    }
-    /* Quick sort */
-    contents = (char**)vlcontents(props);
-    qsort((void*)contents, vllength(props), sizeof(char*), stringveccmp);
-
-    /* print props comma separated */
-    for(i=0;i<vllength(props);i++) {
-	const char* nm = (const char*)vlget(props,i);
-	if(i > 0) vsappend(result,',');
+    /* print props comma separated; the ordered index yields them sorted */
+    for(first=1,node=hashFirst(&ttm->tables.properties,NULL);node != NULL;first=0,node=node->next[0]) {
+	const char* nm = (const char*)node->entry->name;
+	if(!first) vsappend(result,',');
 	vsappendn(result,nm,strlen(nm));
     }
-
-done:
-    vlfree(props);
     TTMFCN_END(ttm,frame,result);
     return THROW(err);
 }
@@ -2771,6 +2930,7 @@ ttm_sort(TTM* ttm, Frame* frame, VString* result)
     vsclear(name->fcn.body);
     vsindexset(name->fcn.body,0);
     vsappendn(name->fcn.body,vscontents(ttm->vs.tmp),vslength(ttm->vs.tmp));
+    invalidatesegments(name);
     /* cleanup */
     vsclear(ttm->vs.tmp);
 
@@ -2844,6 +3004,7 @@ ttm_ttm_meta(TTM* ttm, Frame* frame, VString* result)
 	break;
     default: err = TTM_ETTM; goto done;
     }
+    buildsigtable(ttm);
     vsappendn(result,prev,u8size(prev));
 done:
     TTMFCN_END(ttm,frame,result);
@@ -2868,7 +3029,7 @@ ttm_ttm_info_name(TTM* ttm, Frame* frame, VString* result)
 
     if(frame->argc < 4) EXIT(TTM_EFEWPARMS);
     arg = frame->argv[3];
-    arglen = strlen(arg);
+    arglen = frame->arglen[3];
     str = dictionaryLookup(ttm,arg);
     vsappendn(result,ttm->meta.lbrc,u8size(ttm->meta.lbrc));
     if(str == NULL) { /* not defined*/
@@ -2909,7 +3070,7 @@ ttm_ttm_info_name(TTM* ttm, Frame* frame, VString* result)
 	vsappendn(result,ttm->meta.semic,u8size(ttm->meta.semic));
 	vsappendn(result,info,strlen(info));
 	vsappendn(result,ttm->meta.semic,u8size(ttm->meta.semic));
-	rp = rptocp(ttm,vscontents(str->fcn.body),vsindex(str->fcn.body));
+	if(bodyrptocp(ttm,str,vsindex(str->fcn.body),&rp)) rp = 0;
 	snprintf(info,sizeof(info),"residual=%zu",rp);
 	vsappendn(result,info,strlen(info));
 	vsappendn(result,ttm->meta.semic,u8size(ttm->meta.semic));
@@ -2940,7 +3101,7 @@ ttm_ttm_info_class(TTM* ttm, Frame* frame, VString* result) /* Misc. combined ac
 
     if(frame->argc < 4) EXIT(TTM_EFEWPARMS);
     arg = frame->argv[3];
-    arglen = strlen((const char*)arg);
+    arglen = frame->arglen[3];
     cl = charclassLookup(ttm,arg);
     if(cl == NULL) EXIT(TTM_ENOCLASS);
     vsappendn(result,ttm->meta.lbrc,u8size(ttm->meta.lbrc));
@@ -3009,11 +3170,8 @@ static TTMERR
 ttm_ttm_list(TTM* ttm, Frame* frame, VString* result) /* Misc. combined actions */
 {
     TTMERR err = TTM_NOERR;
-    size_t i;
     int first;
-    VList* vl = vlnew();
-    void* walker = NULL;
-    struct HashEntry* entry = NULL;
+    struct SkipNode* node = NULL;
     enum TTMEnum tte;
     struct HashTable* table = NULL;
 
@@ -3026,49 +3184,145 @@ ttm_ttm_list(TTM* ttm, Frame* frame, VString* result) /* Misc. combined actions
     default: EXIT(TTM_EINVAL);
     }
 
-    /* Pass one: collect all the names */
-    walker = hashwalk(table);
-    while(hashnext(walker,&entry)) {
-	Function* fcn = NULL;
-	Charclass* cl = NULL;
-	switch (tte) {
-	case TE_ALL:
-	    fcn = (Function*)entry;
-	    vlpush(vl,strdup((const char*)fcn->entry.name));
-	    break;
-	case TE_BUILTIN:
-	    fcn = (Function*)entry;
-	    if(fcn->fcn.builtin) vlpush(vl,strdup((const char*)fcn->entry.name));
-	    break;
-	case TE_STRING:
-	    fcn = (Function*)entry;
-	    if(!fcn->fcn.builtin) vlpush(vl,strdup((const char*)fcn->entry.name));
-	    break;
-	case TE_CLASS:
-	    cl = (Charclass*)entry;
-	    vlpush(vl,strdup((const char*)cl->entry.name));
-	    break;
-	default: EXIT(TTM_EINVAL);
-	}
-    }
-    hashwalkstop(walker);
-    /* construct the final result */
+    /* construct the final result; the ordered index yields the names sorted */
     vsappendn(result,(const char*)ttm->meta.lbrc,u8size(ttm->meta.lbrc));
-    for(first=1,i=0;i<vllength(vl);i++,first=0) {
-	const char* name = (const char*)vlget(vl,i);
+    for(first=1,node=hashFirst(table,NULL);node != NULL;node=node->next[0]) {
+	const char* name = (const char*)node->entry->name;
+	if(tte == TE_BUILTIN && !((Function*)node->entry)->fcn.builtin) continue;
+	if(tte == TE_STRING && ((Function*)node->entry)->fcn.builtin) continue;
 	if(!first) vsappendn(result,",",1);
 	vsappendn(result,name,strlen(name));
+	first = 0;
     }
     vsappendn(result,(const char*)ttm->meta.rbrc,u8size(ttm->meta.rbrc));
 done:
     return THROW(err);
 }
 
+/**
+#<ttm;stats;{key}*>
+Return interpreter statistics as <key=value;key=value...>,
+limited to the given keys, if any:
+valloc => no. of heap allocations done by the VArray code
+vfree => no. of heap frees done by the VArray code
+poolalloc => no. of functions, classes and properties allocated from the pools
+poolslabs => no. of slabs obtained from the heap by the pools
+maxdepth => maximum frame stack depth reached so far
+active => allocated size of the active buffer
+cachehit => no. of calls whose function was found in the call cache
+cachemiss => no. of calls that had to search the dictionary
+searchhit => no. of #<scn> patterns found in the searcher cache
+searchmiss => no. of #<scn> patterns that had to be compiled
+gcruns => no. of times the created names were collected
+gccollected => total no. of created names collected
+compactruns => no. of times memory was compacted
+compacted => total no. of bytes given back by compaction
+atoms => no. of names currently interned (see intern())
+*/
+
+static TTMERR
+ttm_ttm_stats(TTM* ttm, Frame* frame, VString* result)
+{
+    TTMERR err = TTM_NOERR;
+    char info[1024];
+    struct Stat {const char* key; unsigned long value;} stats[15];
+    size_t i, j, nstats = 0;
+    int first = 1;
+
+#define STAT(k,v) {stats[nstats].key = (k); stats[nstats].value = (unsigned long)(v); nstats++;}
+    STAT("valloc",vastats.allocs);
+    STAT("vfree",vastats.frees);
+    STAT("poolalloc",ttm->pools.functions.allocs+ttm->pools.charclasses.allocs+ttm->pools.properties.allocs);
+    STAT("poolslabs",ttm->pools.functions.nslabs+ttm->pools.charclasses.nslabs+ttm->pools.properties.nslabs);
+    STAT("maxdepth",ttm->frames.maxtop+1);
+    STAT("active",vsalloc(ttm->vs.active));
+    STAT("cachehit",ttm->callcache.hits);
+    STAT("cachemiss",ttm->callcache.misses);
+    STAT("searchhit",ttm->searchcache.hits);
+    STAT("searchmiss",ttm->searchcache.misses);
+    STAT("gcruns",ttm->gc.runs);
+    STAT("gccollected",ttm->gc.collected);
+    STAT("compactruns",ttm->compact.runs);
+    STAT("compacted",ttm->compact.reclaimed);
+    STAT("atoms",ttm->tables.atoms.nentries);
+#undef STAT
+
+    /* Check the requested keys before producing anything */
+    for(j=2;j<frame->argc;j++) {
+	for(i=0;i<nstats;i++) {if(strcmp(stats[i].key,frame->argv[j])==0) break;}
+	if(i == nstats) EXIT(TTM_ETTMCMD);
+    }
+    vsappendn(result,ttm->meta.lbrc,u8size(ttm->meta.lbrc));
+    for(i=0;i<nstats;i++) {
+	if(frame->argc > 2) {
+	    for(j=2;j<frame->argc;j++) {if(strcmp(stats[i].key,frame->argv[j])==0) break;}
+	    if(j == frame->argc) continue; /* not requested */
+	}
+	if(!first) vsappendn(result,ttm->meta.semic,u8size(ttm->meta.semic));
+	snprintf(info,sizeof(info),"%s=%lu",stats[i].key,stats[i].value);
+	vsappendn(result,info,strlen(info));
+	first = 0;
+    }
+    vsappendn(result,ttm->meta.rbrc,u8size(ttm->meta.rbrc));
+done:
+    return THROW(err);
+}
+
+/**
+#<ttm;gc>
+Collect the unreachable created names now (see gc.h)
+and return the no. of names collected.
+*/
+
+static TTMERR
+ttm_ttm_gc(TTM* ttm, Frame* frame, VString* result)
+{
+    TTMERR err = TTM_NOERR;
+    char info[MAXINTCHARS+1];
+
+    snprintf(info,sizeof(info),"%zu",gcnames(ttm));
+    vsappendn(result,info,strlen(info));
+    return THROW(err);
+}
+
+/**
+#<ttm;compact;{name}*>
+Compact the interpreter's memory now (see gc.h), also dropping
+the consumed prefix of the residual of each named string,
+and return the no. of bytes given back.
+*/
+
+static TTMERR
+ttm_ttm_compact(TTM* ttm, Frame* frame, VString* result)
+{
+    TTMERR err = TTM_NOERR;
+    char info[MAXINTCHARS+1];
+    size_t i, reclaimed = 0;
+
+    for(i=2;i<frame->argc;i++) {
+	Function* str = dictionaryLookup(ttm,frame->argv[i]);
+	if(str == NULL) EXIT(TTM_ENONAME);
+	if(str->fcn.builtin) EXIT(TTM_ENOPRIM);
+	reclaimed += compactresidual(str);
+    }
+    reclaimed += compact(ttm);
+    if(ttm->opts.testing)
+	strncpy(info,fixedtestvalues.compacted,sizeof(info));
+    else
+	snprintf(info,sizeof(info),"%zu",reclaimed);
+    vsappendn(result,info,strlen(info));
+done:
+    return THROW(err);
+}
+
 /**
 #<ttm;meta;which;char>		# Set the value for various meta characters
 #<ttm;info;name;{name}*>	# return info about each {name}
 #<ttm;info;class;{class}*>	# return info about each {class}
 #<ttm;list;{case};{name}*>	# return sorted list of names defined by case
+#<ttm;stats;{key}*>		# return interpreter statistics
+#<ttm;gc>			# collect unreachable created names
+#<ttm;compact;{name}*>		# give back unused memory
 */
 static TTMERR
 ttm_ttm(TTM* ttm, Frame* frame, VString* result) /* Misc. combined actions */
@@ -3104,6 +3358,15 @@ ttm_ttm(TTM* ttm, Frame* frame, VString* result) /* Misc. combined actions */
     case TE_LIST:
 	err = ttm_ttm_list(ttm,frame,result);
 	break;
+    case TE_STATS:
+	err = ttm_ttm_stats(ttm,frame,result);
+	break;
+    case TE_GC:
+	err = ttm_ttm_gc(ttm,frame,result);
+	break;
+    case TE_COMPACT:
+	err = ttm_ttm_compact(ttm,frame,result);
+	break;
     default:
 	EXIT(TTM_ETTMCMD);
 	break;
@@ -3116,11 +3379,14 @@ done:
 /**************************************************/
 
 /**
- Builtin function table
+ Builtin function table.
+ The descriptors are static; at startup, defineBuiltinFunctions
+ turns them into Function objects held in a single block
+ (see TTM.builtins) whose names are the static strings below.
 */
 
 struct Builtin {
-    char* name;
+    const char* name;
     size_t minargs;
     size_t maxargs;
     enum FcnSV sv;
@@ -3134,7 +3400,7 @@ struct Builtin {
 /* Define some temporary macros */
 #define ARB MAXARGS
 
-static struct Builtin builtin_orig[] = {
+static const struct Builtin builtin_orig[] = {
     /* Dictionary Operations */
     {"ap",2,2,SV_S,ttm_ap}, /* Append to a string */
     {"cf",2,2,SV_S,ttm_cf}, /* Copy a function */
@@ -3201,7 +3467,7 @@ static struct Builtin builtin_orig[] = {
 };
 
 /* Functions new to this implementation */
-static struct Builtin builtin_new[] = {
+static const struct Builtin builtin_new[] = {
     {"argv",1,1,SV_V,ttm_argv}, /* Get ith command line argument; 0<=i<argc */
     {"argc",0,0,SV_V,ttm_argc}, /* no. of command line arguments */
     {"classes",0,0,SV_V,ttm_classes}, /* Obtain character class names */
@@ -3236,6 +3502,9 @@ static struct Builtin builtin_new[] = {
     {"wd",0,0,SV_V,ttm_wd}, /* get current working directory */
     {"fps",0,0,SV_V,ttm_fps}, /* platform specific file path separator */
     {"clearpassive",0,0,SV_S,ttm_clearpassive}, /* clear current passive results */
+    {"esp",1,ARB,SV_S,ttm_esp}, /* Erase all strings whose names start with any of the given prefixes */
+    {"dl",2,2,SV_S,ttm_dl}, /* Define a string local to the enclosing call */
+    {"scope",0,1,SV_V,ttm_scope}, /* Return the argument; delimits the names defined by dl */
     {NULL,0,0,SV_SV,NULL} /* end of builtins list */
 };
 
@@ -3274,15 +3543,22 @@ static struct Builtin builtin_irrelevant[] = {
 #endif /*0*/
 
 static void
-defineBuiltinFunction1(TTM* ttm, struct Builtin* bin)
+defineBuiltinFunction1(TTM* ttm, const struct Builtin* bin)
 {
     Function* fcn;
+    Atom* atom;
+    unsigned hash = computehash(bin->name);
 
     /* Make sure we did not define builtin twice */
-    fcn = dictionaryLookup(ttm,bin->name);
+    fcn = dictionaryLookupHash(ttm,bin->name,hash);
     if(fcn != NULL) FAILX(ttm,TTM_EDUPNAME,"fcn=%s\n",bin->name);
-    /* create a new function object */
-    fcn = newFunction(ttm,bin->name);
+    /* fill in the next function object in the block */
+    fcn = &ttm->builtins.functions[ttm->builtins.count];
+    atom = &ttm->builtins.atoms[ttm->builtins.count];
+    ttm->builtins.count++;
+    fcn->entry.hash = hash;
+    fcn->entry.name = internstatic(ttm,bin->name,hash,atom);
+    fcn->fcn.nextsegindex = SEGINDEXFIRST;
     fcn->fcn.builtin = 1;
     fcn->fcn.locked = 1;
     fcn->fcn.minargs = bin->minargs;
@@ -3294,16 +3570,33 @@ defineBuiltinFunction1(TTM* ttm, struct Builtin* bin)
     case SV_SV: fcn->fcn.novalue = 0; break;
     }
     fcn->fcn.fcn = bin->fcn;
-    if(!dictionaryInsert(ttm,fcn)) {
-	freeFunction(ttm,fcn);
-	FAIL(ttm,TTM_ETTM);
-    }
+    if(!dictionaryInsert(ttm,fcn)) FAIL(ttm,TTM_ETTM);
 }
 
+/**
+Define all the builtins using one allocation for
+the Function objects and one for the atoms of their names,
+and size the dictionary and atom tables up front so
+that they do not repeatedly grow.
+@param ttm
+@return void
+*/
 static void
 defineBuiltinFunctions(TTM* ttm)
 {
-    struct Builtin* bin;
+    const struct Builtin* bin;
+    size_t n = 0;
+
+    for(bin=builtin_orig;bin->name != NULL;bin++) n++;
+    for(bin=builtin_new;bin->name != NULL;bin++) n++;
+    assert(ttm->builtins.functions == NULL);
+    ttm->builtins.count = 0;
+    ttm->builtins.functions = (Function*)calloc(n,sizeof(Function));
+    ttm->builtins.atoms = (Atom*)calloc(n,sizeof(Atom));
+    if(ttm->builtins.functions == NULL || ttm->builtins.atoms == NULL)
+	FAIL(ttm,TTM_EMEMORY);
+    hashReserve(&ttm->tables.dictionary,ttm->tables.dictionary.nentries + n);
+    hashReserve(&ttm->tables.atoms,ttm->tables.atoms.nentries + n);
     for(bin=builtin_orig;bin->name != NULL;bin++)
 	defineBuiltinFunction1(ttm,bin);
     for(bin=builtin_new;bin->name != NULL;bin++)
@@ -26,13 +26,16 @@ the set of legal mark indices is limited to 1 - 1024 (1024 segment marks).
 /* Segment index constants */
 #define SEGINDEXFIRST   1 /* Index of the lowest segmark */
 #define CREATEINDEXONLY 0 /* Index for the singular create mark */
+#define SEGTEXT ((size_t)-1) /* Segment.segindex for a run of literal text */
 /* Masks for set/clr the continuation bits */
 #define SEGMARKINDEXMASK ((size_t)0x80)
 #define SEGMARKINDEXUNMASK ((size_t)0x3F)
 #define SEGMARKINDEXSHIFT 6
 /* Misc */
-#define CREATELEN 4 /* # of characters for a create value (not the mark */
+#define CREATELEN 4 /* min. # of characters for a create value (not the mark) */
 #define CREATEFORMAT "%04u"
+#define MAXCREATEDIGITS 10 /* enough for any unsigned create value */
+#define GCKEYS 10000 /* 10^CREATELEN; see gc.h */
 #define MAXSEGMARKS 1024
 
 #define empty_segmark {SEGMARK0,0x80,0x80}
@@ -42,7 +45,22 @@ the set of legal mark indices is limited to 1 - 1024 (1024 segment marks).
 #define ARB           MAXARGS
 #define MAXINCLUDES   64
 #define MAXINTCHARS   32
-#define MAXFRAMEDEPTH 1024
+/* Initial sizes for the frame stack and for a frame's argv; both grow as needed */
+#define FRAMESTACK0   32
+#define FRAMEARGS0    8
+/* No. of entries in the function lookup cache; must be a power of two */
+#define CALLCACHESIZE 256
+/* No. of compiled #<scn> patterns kept, and the longest pattern kept */
+#define SEARCHCACHESIZE 8
+#define SEARCHPATMAX    63
+/* Codepoints between the checkpoints of a body's codepoint index */
+#define CPINDEXSTEP 64
+
+#define POOLSLABSIZE  64 /* elements per slab; see pool.h */
+
+#define SKIPMAXLEVEL  16 /* enough for 4^16 names; see hash.h */
+/* Frames keep their buffers across calls, but trim them back to this size */
+#define FRAMEBUFKEEP  (1<<14)
 
 #define NUL8 '\0'
 #define COMMA ','
@@ -59,6 +77,12 @@ the set of legal mark indices is limited to 1 - 1024 (1024 segment marks).
 /* Like NPI, but only ignored at depth 0 */
 #define NPIDEPTH0 "\n" NPI
 
+/* Contexts in which a byte may be significant; see simd.h */
+#define SIG_SCAN 1 /* scan() at depth 0 */
+#define SIG_ARG  2 /* collectargs() */
+#define SIG_BRC  4 /* inside <...> */
+#define SIG_ALL  (SIG_SCAN|SIG_ARG|SIG_BRC)
+
 /* These non-printable characters are not ignored */
 #define NONPRINTKEEP "\t\c\f"
 
@@ -72,6 +96,8 @@ the set of legal mark indices is limited to 1 - 1024 (1024 segment marks).
 #define DFALTEXECCOUNT	(1<<20)
 #define DFALTSHOWFINAL	0
 #define DFALTSHOWCALL	0
+#define DFALTGCLIMIT	0 /* no automatic collection */
+#define DFALTCOMPACTINTERVAL	0 /* no automatic compaction */
 
 #define DFALTTRACE 0
 #define DFALTVERBOSE 1
@@ -90,6 +116,9 @@ the set of legal mark indices is limited to 1 - 1024 (1024 segment marks).
 /* Max number of pushback codepoints for ttmgetc8 */
 #define MAXPUSHBACK 4 /*codepoints */
 
+/* Bytes read at a time by readfile */
+#define READCHUNK 65536
+
 #define METACHARS "#<;>" /* Fails if these chars were changed */
 
 /* Max number of open files */
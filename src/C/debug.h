@@ -161,18 +161,15 @@ Dump keys of the ttm->tables.dictionary
 static void
 dumpdict0(TTM* ttm, struct HashTable* dict, int printvalues, enum TableType tt)
 {
-    int i;
-    for(i=0;i<HASHSIZE;i++) {
-	int first;
-	struct HashEntry* entry = dict->table[i].next;
-	for(first=1;entry != NULL;first=0) {
-	    if(first) fprintf(stderr,"[%3d]",i);
-	    dumpentry(ttm,tt,entry,printvalues);
-	    xprintf(ttm,"\n");
-	    entry = entry->next;
-	}
+    void* walker = hashwalk(dict);
+    struct HashEntry* entry = NULL;
+    while(hashnext(walker,&entry)) {
+	struct HashWalk* w = (struct HashWalk*)walker;
+	fprintf(stderr,"[%3zu]",w->slot-1);
+	dumpentry(ttm,tt,entry,printvalues);
 	xprintf(ttm,"\n");
     }
+    hashwalkstop(walker);
 }
 
 static void
@@ -246,7 +243,7 @@ dumpstack(TTM* ttm)
     int i;
     for(i=0;i<=ttm->frames.top;i++) {
 	xprintf(ttm,"[%d] ",i);
-	dumpframe(ttm,&ttm->frames.stack[i]);
+	dumpframe(ttm,ttm->frames.stack[i]);
 	xprintf(ttm,"\n");
     }
     fflush(stderr);
@@ -316,7 +313,7 @@ trace1(TTM* ttm, TTMERR err, int depth, int entering, int tracing)
 	fflush(stderr);
 	return;
     }	
-    frame = &ttm->frames.stack[depth];
+    frame = ttm->frames.stack[depth];
     xprintf(ttm,"[%02d] ",depth);
     if(tracing)
 	xprintf(ttm,"%s ",(entering?"begin:":"end:  "));
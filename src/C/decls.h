@@ -35,7 +35,7 @@ struct Debug dfalt_debug = {
 	}
 };
 
-/* Cause <argv;0>, <wd>, <time>, <xtime> to output fixed values
+/* Cause <argv;0>, <wd>, <time>, <xtime>, <ttm;compact> to output fixed values
    so that we can compare to baseline without massaging
 */
 struct Testing {
@@ -44,12 +44,14 @@ struct Testing {
     const char* time;
     const char* xtime;
     const char* fps;
+    const char* compacted;
 } fixedtestvalues = {
     "ttm.exe",		/* .argv0 */
     "/ttm/src/C",	/* .wd */
     ":time:",		/* .time */
     ":xtime:",		/* .xtime */
     "/",		/* .fps */
+    ":compacted:",	/* .compacted; byte counts vary by platform */
 };
 
 static VList* argoptions = NULL; /* command line arguments */
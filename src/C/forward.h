@@ -1,21 +1,24 @@
 /* ttmX.c Core execution functions */
 static TTMERR scan(TTM* ttm);
-static TTMERR collectargs(TTM* ttm, Frame* frame);
-static TTMERR exec(TTM* ttm);
-static TTMERR call(TTM* ttm, Frame* frame, char* body, VString* result);
+static TTMERR collectargs(TTM* ttm, Frame* frame, int* completep);
+static TTMERR exec(TTM* ttm, Frame* frame);
+static TTMERR startcall(TTM* ttm);
+static int iscall(TTM* ttm, const char* cp8);
+static TTMERR call(TTM* ttm, Frame* frame, Function* fcn, VString* result);
 static TTMERR printstring(TTM* ttm, const char* s8, TTMFILE* output);
 static char* cleanstring(const char* s8, char* ctrls, size_t* pfinallen);
 static Function* getdictstr(TTM* ttm,const Frame* frame,size_t argi);
 static TTMERR execcmd(TTM* ttm, const char* cmd);
 static void lockup(TTM* ttm);
 static const char* sv(Function* f);
-static const char* peek(VString* vs, size_t n);
-static size_t rptocp(TTM* ttm, const char* u8, size_t rp);
+static const char* peek(const char* cp8, size_t n);
+static int metafree(TTM* ttm, const char* s8, size_t len);
 static size_t cptorp(TTM* ttm, const char* u8, size_t cp);
 static int tfcvt(const char*);
 static void initTTM();
 static void usage(const char* msg);
-static TTMERR readline(TTM* ttm, TTMFILE* f, char** linep);
+static TTMERR readline(TTM* ttm, const char** pp, const char* end, VString* buf);
+static int hascomment(const char* text, size_t len);
 static TTMERR readfile(TTM* ttm, const char* fname, VString* buf);
 static char* unescape(const char* s8);
 static void setproperty(TTM*, const char* key, const char* value);
@@ -25,35 +28,63 @@ static size_t propdfalt(enum PropEnum key);
 static void defaultproperties(TTM* ttm);
 static void cmdlineproperties(TTM* ttm);
 
+static void sigmeta(TTM* ttm, const char* cp8, int flags);
+static void buildsigtable(TTM* ttm);
+static size_t sigspan(TTM* ttm, const char* s8, size_t len, int flags);
+
 static int u8sizec(char c);
 static int u8size(const char* cp);
+static unsigned u8decode(const char* cp);
 static int u8validcp(char* cp);
 static void ascii2u8(char c, char* u8);
 static int u8equal(const char* c1, const char* c2);
 static int memcpycp(char* dst, const char* src);
-static const char* u8ithcp(const char* base, size_t n);
-static int u8ith(const char* base, size_t n);
 static const char* u8backup(const char* p0, const char* base);
 static TTMERR u8peek(char* s, size_t n, char* cpa);
 static TTMERR strsubcp(const char* sstart, size_t send, size_t* pncp);
 static const char* strchr8(const char* s, const char* cp);
-static const char* strstr8(const char* s, const char* pattern);
 /* ttmX.c Utility functions */
 static unsigned computehash(const char* name);
-static int hashLocate(struct HashTable* table, const char* name, struct HashEntry** prevp);
-static void hashRemove(struct HashTable* table, struct HashEntry* prev, struct HashEntry* entry);
-static void hashInsert(struct HashTable* table, struct HashEntry* prev, struct HashEntry* entry);
+static unsigned computehashn(const char* name, size_t len);
+static int hashLocateHash(struct HashTable* table, const char* name, unsigned hash, struct HashEntry** entryp);
+static int hashLocate(struct HashTable* table, const char* name, struct HashEntry** entryp);
+static void hashRemove(struct HashTable* table, struct HashEntry* entry);
+static void hashInsert(struct HashTable* table, struct HashEntry* entry);
+static void hashGrow(struct HashTable* table);
+static void hashResize(struct HashTable* table, size_t newalloc);
+static void hashReserve(struct HashTable* table, size_t n);
+static size_t hashCompact(struct HashTable* table);
+static void hashOrder(struct HashTable* table);
+static struct SkipNode* hashFirst(struct HashTable* table, const char* prefix);
+static struct SkipList* skipNew(void);
+static void skipFree(struct SkipList* sl);
+static int skipLevel(struct SkipList* sl);
+static struct SkipNode* skipFind(struct SkipList* sl, const char* name, struct SkipNode** update);
+static void skipInsert(struct SkipList* sl, struct HashEntry* entry);
+static void skipRemove(struct SkipList* sl, struct HashEntry* entry);
+static void hashClear(struct HashTable* table);
 static void* hashwalk(struct HashTable* table);
 static void hashwalkstop(void* walkstate);
 static int hashnext(void* walkstate, struct HashEntry** ithentryp);
+static void poolinit(struct Pool* pool, size_t elemsize);
+static void* poolalloc(struct Pool* pool);
+static void poolfree(struct Pool* pool, void* elem);
+static void poolclear(struct Pool* pool);
+static size_t poolshrink(struct Pool* pool);
 static Function* dictionaryLookup(TTM* ttm, const char* name);
+static Function* localLookup(TTM* ttm, const char* name, unsigned hash);
+static void localInsert(TTM* ttm, Frame* frame, Function* fcn);
+static Function* localRemove(TTM* ttm, const char* name);
+static void clearLocals(TTM* ttm, Frame* frame);
 static Function* dictionaryRemove(TTM* ttm, const char* name);
+static void globalRemove(TTM* ttm, Function* def);
 static int dictionaryInsert(TTM* ttm, Function* fcn);
 static Charclass* charclassLookup(TTM* ttm, const char* name);
 static Charclass* charclassRemove(TTM* ttm, const char* name);
 static int charclassInsert(TTM* ttm, Charclass* cl);
 static const char* propertyLookup(TTM* ttm, const char* name);
 static Property* propertyRemove(TTM* ttm, const char* name);
+static void freeProperty(TTM* ttm, Property* f);
 static int propertyInsert(TTM* ttm, const char* key, const char* value);
 static TTM* newTTM(struct Properties*);
 static void freeTTM(TTM* ttm);
@@ -61,16 +92,43 @@ static void clearHashEntry(struct HashEntry* entry);
 static Frame* pushFrame(TTM* ttm);
 static void popFrame(TTM* ttm);
 static void clearFrame(TTM* ttm, Frame* frame);
-static void clearArgv(char** argv, size_t argc);
+static void clearArgv(Frame* frame);
+static void pushArgv(TTM* ttm, Frame* frame, const char* arg, size_t arglen);
+static void growArgv(TTM* ttm, Frame* frame, size_t need);
 static void clearFramestack(TTM* ttm);
+static char* intern(TTM* ttm, const char* name, unsigned hash);
+static char* internstatic(TTM* ttm, const char* name, unsigned hash, Atom* atom);
+static void releaseatom(TTM* ttm, char* name, unsigned hash);
+static size_t gcnames(TTM* ttm);
+static size_t compact(TTM* ttm);
+static void clearatoms(TTM* ttm, struct HashTable* atoms);
+static Function* dictionaryLookupHash(TTM* ttm, const char* name, unsigned hash);
+static Function* callcacheLookup(TTM* ttm, const char* name, unsigned hash);
+static const struct Searcher* searcherLookup(TTM* ttm, const char* pattern, size_t plen);
 static Function* newFunction(TTM* ttm, const char* name);
 static void resetFunction(TTM* ttm, Function* f);
+static void buildsegments(TTM* ttm, Function* f);
+static void invalidatesegments(Function* f);
+static int buildcpindex(TTM* ttm, Function* f);
+static TTMERR bodyrptocp(TTM* ttm, Function* f, size_t rp, size_t* cpp);
+static size_t bodycptorp(TTM* ttm, Function* f, size_t cp);
 static void freeFunction(TTM* ttm, Function* f);
+static int isbuiltinslot(TTM* ttm, Function* f);
 static void clearDictionary(TTM* ttm, struct HashTable* dict);
 static Charclass* newCharclass(TTM* ttm, const char* name);
 static void freeCharclass(TTM* ttm, Charclass* cl);
 static void clearcharclasses(TTM* ttm, struct HashTable* charclasses);
-static const char* charclassmatch(const char* cp, const char* charclass, int negative);
+static void compilecharclass(TTM* ttm, Charclass* cl);
+static int charclassrange(const Charclass* cl, unsigned c);
+static const char* charclassmatch(const Charclass* cl, const char* cp, size_t len);
+static size_t asciispan(const char* s8, size_t len);
+static size_t u8validspan(const char* s8, size_t len);
+static size_t u8count(const char* s8, size_t len);
+static size_t u8skip(const char* s8, size_t len, size_t n);
+static size_t classspan(const Charclass* cl, const char* s8, size_t len);
+static int byterank(utf8 c);
+static void searchcompile(struct Searcher* s, const char* pattern, size_t plen, unsigned hash);
+static const char* searchfind(const struct Searcher* s, const char* text, size_t tlen);
 static enum PropEnum propenumdetect(const char* s);
 static enum TTMEnum ttmenumdetect(const char* s);
 static enum MetaEnum metaenumdetect(const char* s);
@@ -98,9 +156,12 @@ static void memmovex(char* dst, char* src, size_t len);
 #endif
 
 /* HashTable operations */
-static int hashLocate(struct HashTable* table, const char* name, struct HashEntry** prevp);
-static void hashRemove(struct HashTable* table, struct HashEntry* prev, struct HashEntry* entry);
-static void hashInsert(struct HashTable* table, struct HashEntry* prev, struct HashEntry* entry);
+static int hashLocate(struct HashTable* table, const char* name, struct HashEntry** entryp);
+static void hashRemove(struct HashTable* table, struct HashEntry* entry);
+static void hashInsert(struct HashTable* table, struct HashEntry* entry);
+static void hashGrow(struct HashTable* table);
+static void hashReserve(struct HashTable* table, size_t n);
+static void hashClear(struct HashTable* table);
 static void* hashwalk(struct HashTable* table);
 static void hashwalkstop(void* walkstate);
 static int hashnext(void* walkstate, struct HashEntry** ithentryp);
@@ -109,8 +170,14 @@ static TTMERR ttm_ap(TTM* ttm, Frame* frame, VString*);
 static TTMERR ttm_ap(TTM* ttm, Frame* frame, VString* result);
 static TTMERR ttm_cf(TTM* ttm, Frame* frame, VString* result);
 static TTMERR ttm_ds(TTM* ttm, Frame* frame, VString* result);
+static TTMERR ttm_dl(TTM* ttm, Frame* frame, VString* result);
+static TTMERR ttm_scope(TTM* ttm, Frame* frame, VString* result);
 static TTMERR ttm_es(TTM* ttm, Frame* frame, VString* result);
-static TTMERR ttm_subst(TTM* ttm, VString* text, const char* pattern, size_t segindex, size_t* segcountp);
+static TTMERR ttm_esp(TTM* ttm, Frame* frame, VString* result);
+static size_t substsearch(const char* text, size_t tlen, const char* pat, size_t plen, const size_t* skip);
+static void substskip(const char* pat, size_t plen, size_t* skip);
+static void substrebuild(TTM* ttm, VString* text, VArray* matches);
+static TTMERR ttm_subst(TTM* ttm, VString* text, char** patterns, size_t npatterns, size_t segindex, size_t* segcountp);
 static TTMERR ttm_sc(TTM* ttm, Frame* frame, VString* result);
 static TTMERR ttm_ss(TTM* ttm, Frame* frame, VString* result);
 static TTMERR ttm_cr(TTM* ttm, Frame* frame, VString* result);
@@ -199,6 +266,9 @@ static TTMERR ttm_ttm_info_name(TTM* ttm, Frame* frame, VString* result);
 static TTMERR ttm_ttm_info_class(TTM* ttm, Frame* frame, VString* result);
 static TTMERR ttm_ttm_info_string(TTM* ttm, Frame* frame, VString* result);
 static TTMERR ttm_ttm_list(TTM* ttm, Frame* frame, VString* result);
+static TTMERR ttm_ttm_stats(TTM* ttm, Frame* frame, VString* result);
+static TTMERR ttm_ttm_gc(TTM* ttm, Frame* frame, VString* result);
+static TTMERR ttm_ttm_compact(TTM* ttm, Frame* frame, VString* result);
 static TTMERR ttm_ttm(TTM* ttm, Frame* frame, VString* result);
 
 static TTMFILE* ttmopen(TTM* ttm, const char* fname, const char* mode);
@@ -0,0 +1,414 @@
+/**************************************************/
+/**
+Reclaiming memory: collection of unreachable created names
+(gcnames) and compaction of what remains (compact).
+
+Collection of unreachable created names.
+
+Programs commonly use create marks (see #<cr>) to make unique
+names for temporaries, e.g. #<ds;tmp0042;...>, and then never
+erase them. The collector reclaims such names once no text
+that could still be executed refers to them.
+
+A name is a candidate for collection if it is not builtin,
+not locked, and it contains a run of at least CREATELEN digits
+whose value could have come from a create mark, i.e. it is
+between 1 and ttm->flags.crcounter. Every other name is kept.
+
+A candidate is reachable if its name occurs anywhere in
+a root text, or in the body of a reachable candidate.
+The root texts are:
+1. the bodies of all the non-candidate strings,
+2. the arguments, results and local names of all pending calls,
+3. the unscanned part of the active buffer, the passive buffer
+   except for the final output, the tmp and result buffers,
+   and the same for the scans suspended by #<catch>, and
+4. the property values.
+
+Since names are found by plain substring search,
+the collector is conservative: any mention keeps a name alive.
+But a name that is only ever computed, e.g. #<tmp#<n>>,
+cannot be seen, which is why collection is optional.
+It is done by #<ttm;gc> or, if the gclimit property is
+non-zero, whenever the no. of functions reaches a threshold
+(initially gclimit; afterwards twice the no. that survived).
+
+To find the candidates quickly, each one is keyed
+by the last CREATELEN digits of its digit run,
+and the texts are searched for CREATELEN digit windows.
+*/
+
+struct GCName {
+    Function* fcn;
+    size_t len; /* strlen(name) */
+    size_t anchor; /* offset in name of the key digits */
+    size_t next; /* next candidate with the same key; 0 => none; 1-based */
+    int reached;
+};
+
+struct GCState {
+    struct GCName* names; /* the candidates */
+    size_t nnames;
+    size_t* keys; /* |keys| == GCKEYS; first candidate for each key; 0 => none */
+    size_t* work; /* reached candidates whose bodies are not yet searched */
+    size_t nwork;
+};
+
+/**
+Decide if a name is a candidate for collection.
+@param ttm
+@param name
+@param anchorp return the offset of the key digits
+@return 1 if a candidate, 0 otherwise
+*/
+static int
+gccandidate(TTM* ttm, const char* name, size_t* anchorp)
+{
+    const char* p = name;
+    int found = 0;
+
+    while(*p) {
+	const char* q;
+	if(*p < '0' || *p > '9') {p++; continue;}
+	for(q=p;*q >= '0' && *q <= '9';q++);
+	if((q - p) >= CREATELEN && (q - p) <= MAXCREATEDIGITS) {
+	    unsigned long n = strtoul(p,NULL,10);
+	    if(n >= 1 && n <= ttm->flags.crcounter) {
+		*anchorp = (size_t)((q - CREATELEN) - name);
+		found = 1; /* keep looking; the last such run is used */
+	    }
+	}
+	p = q;
+    }
+    return found;
+}
+
+/* Convert CREATELEN digits to a key */
+static size_t
+gckey(const char* p)
+{
+    size_t key = 0;
+    int i;
+    for(i=0;i<CREATELEN;i++) key = (key * 10) + (size_t)(p[i] - '0');
+    return key;
+}
+
+/**
+Mark every candidate whose name occurs in some text.
+@param gc
+@param text to search
+@param len of text in bytes; text need not be nul terminated
+@return void
+*/
+static void
+gcsearch(struct GCState* gc, const char* text, size_t len)
+{
+    size_t i;
+    size_t run = 0; /* no. of consecutive digits ending at text[i] */
+
+    for(i=0;i<len;i++) {
+	size_t c, start;
+	if(text[i] < '0' || text[i] > '9') {run = 0; continue;}
+	if(++run < CREATELEN) continue;
+	start = i + 1 - CREATELEN; /* the window is text[start..i] */
+	for(c=gc->keys[gckey(text+start)];c != 0;c=gc->names[c-1].next) {
+	    struct GCName* gn = &gc->names[c-1];
+	    if(gn->reached || start < gn->anchor) continue;
+	    if((start - gn->anchor) + gn->len > len) continue;
+	    if(memcmp(text+(start - gn->anchor),gn->fcn->entry.name,gn->len) != 0) continue;
+	    gn->reached = 1;
+	    gc->work[gc->nwork++] = c;
+	}
+    }
+}
+
+/* Search the body of a string, if any */
+static void
+gcsearchbody(struct GCState* gc, Function* f)
+{
+    if(!f->fcn.builtin && f->fcn.body != NULL)
+	gcsearch(gc,vscontents(f->fcn.body),vslength(f->fcn.body));
+}
+
+/**
+Search the buffers of a scan.
+@param ttm
+@param gc
+@param active buffer
+@param passive buffer
+@param outermost 1 => this is the top level scan
+@return void
+*/
+static void
+gcsearchscan(TTM* ttm, struct GCState* gc, VString* active, VString* passive, int outermost)
+{
+    size_t start = 0;
+
+    /* The text before the active index has been scanned already */
+    gcsearch(gc,vsindexp(active),vslength(active)-vsindex(active));
+    /* The passive text of the top level scan that precedes
+       all pending calls is final output */
+    if(outermost && ttm->frames.top >= 0) start = ttm->frames.stack[0]->savepassive;
+    if(start < vslength(passive))
+	gcsearch(gc,vscontents(passive)+start,vslength(passive)-start);
+}
+
+/**
+Search all the root texts except the bodies in the dictionary.
+@param ttm
+@param gc
+@return void
+*/
+static void
+gcsearchroots(TTM* ttm, struct GCState* gc)
+{
+    int i;
+    struct SkipNode* node;
+    struct Suspended* s;
+
+    for(i=0;i<=ttm->frames.top;i++) {
+	Frame* frame = ttm->frames.stack[i];
+	Function* f;
+	/* The args are nul separated in the arena, which is fine */
+	gcsearch(gc,vscontents(frame->args),vslength(frame->args));
+	gcsearch(gc,vscontents(frame->result),vslength(frame->result));
+	for(f=frame->locals;f != NULL;f=f->nextlocal) gcsearchbody(gc,f);
+    }
+    gcsearchscan(ttm,gc,ttm->vs.active,ttm->vs.passive,(ttm->vs.suspended == NULL));
+    for(s=ttm->vs.suspended;s != NULL;s=s->next)
+	gcsearchscan(ttm,gc,s->active,s->passive,(s->next == NULL));
+    gcsearch(gc,vscontents(ttm->vs.tmp),vslength(ttm->vs.tmp));
+    gcsearch(gc,vscontents(ttm->vs.result),vslength(ttm->vs.result));
+    for(node=hashFirst(&ttm->tables.properties,NULL);node != NULL;node=node->next[0]) {
+	const char* value = ((Property*)node->entry)->value;
+	if(value != NULL) gcsearch(gc,value,strlen(value));
+    }
+}
+
+/**
+Erase a collected function; freeFunction() also releases
+the atom for its name if nothing else uses it.
+@param ttm
+@param f
+@return void
+*/
+static void
+gcerase(TTM* ttm, Function* f)
+{
+    hashRemove(&ttm->tables.dictionary,(struct HashEntry*)f);
+    freeFunction(ttm,f); /* also invalidates the call cache */
+}
+
+/**
+Collect the unreachable created names.
+@param ttm
+@return no. of names collected
+*/
+static size_t
+gcnames(TTM* ttm)
+{
+    struct GCState gc;
+    struct SkipNode* node;
+    size_t i, ncollected = 0;
+
+    memset(&gc,0,sizeof(gc));
+    ttm->gc.runs++;
+    if(ttm->flags.crcounter == 0) goto done; /* no create marks were ever used */
+
+    /* Find the candidates; the ordered index also gives them a stable order */
+    gc.names = (struct GCName*)calloc(ttm->tables.dictionary.nentries+1,sizeof(struct GCName));
+    gc.keys = (size_t*)calloc(GCKEYS,sizeof(size_t));
+    if(gc.names == NULL || gc.keys == NULL) FAIL(ttm,TTM_EMEMORY);
+    for(node=hashFirst(&ttm->tables.dictionary,NULL);node != NULL;node=node->next[0]) {
+	Function* f = (Function*)node->entry;
+	struct GCName* gn = &gc.names[gc.nnames];
+	size_t key;
+	if(f->fcn.builtin || f->fcn.locked) continue;
+	if(!gccandidate(ttm,f->entry.name,&gn->anchor)) continue;
+	gn->fcn = f;
+	gn->len = strlen(f->entry.name);
+	key = gckey(f->entry.name+gn->anchor);
+	gn->next = gc.keys[key];
+	gc.keys[key] = ++gc.nnames; /* 1-based */
+    }
+    if(gc.nnames == 0) goto done;
+    gc.work = (size_t*)calloc(gc.nnames,sizeof(size_t));
+    if(gc.work == NULL) FAIL(ttm,TTM_EMEMORY);
+
+    /* Mark */
+    gcsearchroots(ttm,&gc);
+    for(node=hashFirst(&ttm->tables.dictionary,NULL);node != NULL;node=node->next[0]) {
+	Function* f = (Function*)node->entry;
+	size_t anchor;
+	if(!f->fcn.builtin && !f->fcn.locked && gccandidate(ttm,f->entry.name,&anchor))
+	    continue; /* searched only if reached */
+	gcsearchbody(&gc,f);
+    }
+    while(gc.nwork > 0)
+	gcsearchbody(&gc,gc.names[gc.work[--gc.nwork]-1].fcn);
+
+    /* Sweep */
+    for(i=0;i<gc.nnames;i++) {
+	if(gc.names[i].reached) continue;
+	gcerase(ttm,gc.names[i].fcn);
+	ncollected++;
+    }
+
+done:
+    ttm->gc.collected += ncollected;
+    /* Do not collect again until the no. of functions has doubled */
+    ttm->gc.threshold = 2*ttm->pools.functions.inuse;
+    if(ttm->gc.threshold < ttm->properties.gclimit) ttm->gc.threshold = ttm->properties.gclimit;
+    nullfree(gc.names);
+    nullfree(gc.keys);
+    nullfree(gc.work);
+    return ncollected;
+}
+
+/**************************************************/
+/**
+Compaction.
+
+Strings only ever grow their buffers, so a program that builds
+large intermediate strings and then cuts them down (#<ds>, #<ap>,
+#<cn>, #<ss>, ...) keeps the peak size of each of them. Likewise
+the hash tables and pools keep their peak size after names are
+erased or collected. Compaction gives back that slack:
+1. each (unshared) string body and its segment list is
+   shrunk to fit,
+2. the dictionary, character class, property and atom
+   tables are shrunk to the size that their current
+   entries require,
+3. the pool slabs holding no live objects are released,
+4. the frames above the deepest pending call are freed, and
+5. the scanned part of the active buffer is dropped, and the
+   interpreter buffers are trimmed to FRAMEBUFKEEP or to fit.
+The consumed prefix of a string's residual is NOT dropped,
+since #<rrp> may still reset the residual to the start
+and a call always uses the whole body; #<ttm;compact;name...>
+drops it for the named strings only.
+Compaction is done by #<ttm;compact> or, if the compactinterval
+property is non-zero, after every compactinterval calls.
+It never moves a Function, so it is safe whenever a
+collection is (see exec).
+*/
+
+/* Trim va to max(length+1,keep) elements; return the no. of bytes given back.
+   The +1 is because vaindexset() expects room for index+1 elements,
+   and would otherwise reallocate when the index reaches the end */
+static size_t
+compacttrim(VArray* va, size_t keep)
+{
+    size_t oldalloc;
+
+    if(va == NULL || va->content == NULL) return 0;
+    /* Trimming a shared body would copy it */
+    if(va->shared != NULL && *va->shared > 1) return 0;
+    if(keep < va->length+1) keep = va->length+1;
+    oldalloc = va->alloc;
+    vatrim(va,keep);
+    return (oldalloc - va->alloc) * va->elemsize;
+}
+
+/* Shrink the body and segment list of a string to fit */
+static size_t
+compactfunction(Function* f)
+{
+    size_t reclaimed = 0;
+    if(f->fcn.builtin) return 0;
+    reclaimed += compacttrim((VArray*)f->fcn.body,0);
+    reclaimed += compacttrim(f->fcn.segments,0);
+    reclaimed += compacttrim(f->fcn.cpindex,0);
+    return reclaimed;
+}
+
+/**
+Drop the consumed prefix of a string's residual,
+after which the residual cannot be reset to it.
+@param f
+@return the no. of bytes dropped
+*/
+static size_t
+compactresidual(Function* f)
+{
+    size_t consumed;
+
+    if(f->fcn.builtin || f->fcn.body == NULL) return 0;
+    consumed = vsindex(f->fcn.body);
+    if(consumed == 0) return 0;
+    vsremoven(f->fcn.body,0,consumed);
+    vsindexset(f->fcn.body,0);
+    invalidatesegments(f);
+    return consumed;
+}
+
+/**
+Free the frames above the top of the frame stack;
+pushFrame re-creates them on demand.
+@param ttm
+@return the no. of bytes given back
+*/
+static size_t
+compactframes(TTM* ttm)
+{
+    size_t i, reclaimed = 0;
+
+    for(i=(size_t)(ttm->frames.top+1);i<ttm->frames.alloc;i++) {
+	Frame* f = ttm->frames.stack[i];
+	if(f == NULL) continue;
+	reclaimed += sizeof(Frame) + f->argalloc*(sizeof(char*)+sizeof(size_t));
+	reclaimed += vsalloc(f->args) + vsalloc(f->result);
+	assert(f->locals == NULL);
+	vsfree(f->args);
+	vsfree(f->result);
+	nullfree(f->argv);
+	nullfree(f->arglen);
+	free(f);
+	ttm->frames.stack[i] = NULL;
+    }
+    return reclaimed;
+}
+
+/**
+Compact the interpreter's memory; see above.
+The arguments of pending calls are left alone,
+since their argv point into them.
+@param ttm
+@return the no. of bytes given back
+*/
+static size_t
+compact(TTM* ttm)
+{
+    struct SkipNode* node;
+    size_t reclaimed = 0;
+    int i;
+
+    ttm->compact.runs++;
+    for(node=hashFirst(&ttm->tables.dictionary,NULL);node != NULL;node=node->next[0])
+	reclaimed += compactfunction((Function*)node->entry);
+    for(i=0;i<=ttm->frames.top;i++) {
+	Function* f;
+	for(f=ttm->frames.stack[i]->locals;f != NULL;f=f->nextlocal)
+	    reclaimed += compactfunction(f);
+    }
+    reclaimed += hashCompact(&ttm->tables.dictionary);
+    reclaimed += hashCompact(&ttm->tables.charclasses);
+    reclaimed += hashCompact(&ttm->tables.properties);
+    reclaimed += hashCompact(&ttm->tables.atoms);
+    reclaimed += poolshrink(&ttm->pools.functions);
+    reclaimed += poolshrink(&ttm->pools.charclasses);
+    reclaimed += poolshrink(&ttm->pools.properties);
+    reclaimed += compactframes(ttm);
+    /* Nothing refers to the scanned part of the active buffer */
+    if(vsindex(ttm->vs.active) > 0) {
+	vsremoven(ttm->vs.active,0,vsindex(ttm->vs.active));
+	vsindexset(ttm->vs.active,0);
+    }
+    reclaimed += compacttrim((VArray*)ttm->vs.active,FRAMEBUFKEEP);
+    reclaimed += compacttrim((VArray*)ttm->vs.passive,FRAMEBUFKEEP);
+    reclaimed += compacttrim((VArray*)ttm->vs.tmp,FRAMEBUFKEEP);
+    reclaimed += compacttrim((VArray*)ttm->vs.result,FRAMEBUFKEEP);
+    ttm->compact.reclaimed += reclaimed;
+    ttm->compact.countdown = ttm->properties.compactinterval;
+    return reclaimed;
+}
@@ -1,81 +1,317 @@
 /**************************************************/
 /**
 HashTable Management:
-The table is only pseudo-hash simplified by making it an array
-of chains indexed by the low order n bits of the name[0].  The
-hashcode is just the simple sum of the characters in the name
-shifted by 1 bit each.
+The table is an open addressing table using linear probing.
+The number of slots is a power of two and the table is doubled
+whenever it becomes half full, so probe sequences stay short.
+Removal shifts later members of the probe sequence back,
+so no tombstones are needed.
+The hashcode is the 32-bit FNV-1a hash of the name.
+
+A table may also keep an ordered index of its entries (see hashOrder):
+a skiplist sorted by name that is updated by hashInsert and hashRemove,
+so that sorted listings and prefix queries need no sorting and only
+touch the matching entries.
 */
 
-/* Define a hash computing macro */
+#define FNV32BASIS 2166136261U
+#define FNV32PRIME 16777619U
+
+/* Define a hash computing function */
 static unsigned
 computehash(const char* name)
+{
+    return computehashn(name,strlen(name));
+}
+
+static unsigned
+computehashn(const char* name, size_t len)
 {
     unsigned hash;
     const char* p;
-    for(hash=0,p=name;*p!=NUL8;p++) hash = hash + (*UTF8P(p) <<1);
+    const char* end = name + len;
+    for(hash=FNV32BASIS,p=name;p < end;p++) {
+	hash ^= (unsigned)(*UTF8P(p));
+	hash *= FNV32PRIME;
+    }
+    hash &= 0xFFFFFFFFU;
     if(hash==0) hash=1;
     return hash;
 }
 
+#define hashslot(table,hash) ((size_t)(hash) & ((table)->alloc - 1))
+#define hashstep(table,slot) (((slot) + 1) & ((table)->alloc - 1))
+
 /* Locate a named entry in the hashtable;
    return 1 if found; 0 otherwise.
-   prev is a pointer to HashEntry "before" the found entry.
+   If found, then *entryp is the entry.
 */
 
 static int
-hashLocate(struct HashTable* table, const char* name, struct HashEntry** prevp)
+hashLocate(struct HashTable* table, const char* name, struct HashEntry** entryp)
 {
-    struct HashEntry* prev;
-    struct HashEntry* next;
-    unsigned index;
-    unsigned hash;
+    return hashLocateHash(table,name,computehash(name),entryp);
+}
+
+/* As hashLocate, but with hash == computehash(name) already known.
+   If name is an atom (see intern()), then a match is found
+   by pointer comparison alone.
+*/
+
+static int
+hashLocateHash(struct HashTable* table, const char* name, unsigned hash, struct HashEntry** entryp)
+{
+    struct HashEntry* entry;
+    size_t slot;
 
-    hash = computehash(name);
-    if(!(table != NULL && name != NULL))
     assert(table != NULL && name != NULL);
-    index = (((unsigned)(name[0])) & HASHTABLEMASK);
-    prev = &table->table[index];
-    next = prev->next;
-    while(next != NULL) {
-	if(next->hash == hash
-	   && strcmp((char*)name,(char*)next->name)==0)
-	    break;
-	prev = next;
-	next = next->next;
+    if(table->alloc == 0) return 0;
+    for(slot=hashslot(table,hash);(entry=table->table[slot]) != NULL;slot=hashstep(table,slot)) {
+	if(entry->name == name
+	   || (entry->hash == hash
+	       && strcmp((char*)name,(char*)entry->name)==0)) {
+	    if(entryp) *entryp = entry;
+	    return 1;
+	}
     }
-    if(prevp) *prevp = prev;
-    return (next == NULL ? 0 : 1);
+    return 0;
+}
+
+/* Double the size of the table and re-insert all the entries */
+static void
+hashGrow(struct HashTable* table)
+{
+    hashResize(table,(table->alloc == 0 ? HASHSIZE : 2*table->alloc));
+}
+
+/* Give the table newalloc slots and re-insert all the entries;
+   newalloc must be a power of two that can hold them. */
+static void
+hashResize(struct HashTable* table, size_t newalloc)
+{
+    struct HashEntry** oldtable = table->table;
+    size_t oldalloc = table->alloc;
+    size_t i;
+
+    table->alloc = newalloc;
+    table->table = (struct HashEntry**)calloc(table->alloc,sizeof(struct HashEntry*));
+    assert(table->table != NULL);
+    for(i=0;i<oldalloc;i++) {
+	struct HashEntry* entry = oldtable[i];
+	size_t slot;
+	if(entry == NULL) continue;
+	for(slot=hashslot(table,entry->hash);table->table[slot] != NULL;slot=hashstep(table,slot));
+	table->table[slot] = entry;
+    }
+    nullfree(oldtable);
+}
+
+/* Grow the table, if necessary, so that it can hold n entries
+   without growing again; used when many entries are inserted at once.
+*/
+static void
+hashReserve(struct HashTable* table, size_t n)
+{
+    while(2*n > table->alloc) hashGrow(table);
+}
+
+/* Shrink the table to the smallest size that hashInsert
+   would have grown it to for its current entries.
+   @return the no. of bytes given back
+*/
+static size_t
+hashCompact(struct HashTable* table)
+{
+    size_t newalloc = HASHSIZE;
+    size_t oldalloc = table->alloc;
+
+    if(oldalloc == 0) return 0;
+    while(2*table->nentries > newalloc) newalloc *= 2;
+    if(newalloc >= oldalloc) return 0;
+    hashResize(table,newalloc);
+    return (oldalloc - newalloc) * sizeof(struct HashEntry*);
 }
 
 /* Remove an entry specified by argument 'entry'.
-   Assumes that the predecessor of entry is specified
-   by 'prev' as returned by hashLocate.
+   Assumes that the entry is in the table as returned by hashLocate.
 */
 
 static void
-hashRemove(struct HashTable* table, struct HashEntry* prev, struct HashEntry* entry)
+hashRemove(struct HashTable* table, struct HashEntry* entry)
 {
-   assert(table != NULL && prev != NULL && entry != NULL);
-   assert(prev->next == entry); /* validate the removal */
-   prev->next = entry->next;
-   table->nentries--;
+    size_t slot, next;
+
+    assert(table != NULL && entry != NULL && table->alloc > 0);
+    for(slot=hashslot(table,entry->hash);table->table[slot] != entry;slot=hashstep(table,slot))
+	assert(table->table[slot] != NULL); /* validate the removal */
+    /* Shift back any following entries whose probe sequence passes through slot */
+    for(next=hashstep(table,slot);table->table[next] != NULL;next=hashstep(table,next)) {
+	size_t home = hashslot(table,table->table[next]->hash);
+	/* Can the entry at next move to slot? (i.e. home is cyclically outside (slot,next]) */
+	if(slot <= next ? (home <= slot || home > next) : (home <= slot && home > next)) {
+	    table->table[slot] = table->table[next];
+	    slot = next;
+	}
+    }
+    table->table[slot] = NULL;
+    table->nentries--;
+    if(table->ordered != NULL) skipRemove(table->ordered,entry);
 }
 
 
 /* Insert an entry specified by argument 'entry'.
-   Assumes that the predecessor of entry is specified
-   by 'prev' as returned by hashLocate.
+   Assumes that the entry is not already in the table
+   as determined by hashLocate.
+*/
+
+static void
+hashInsert(struct HashTable* table, struct HashEntry* entry)
+{
+    size_t slot;
+
+    assert(table != NULL && entry != NULL);
+    assert(entry->hash != 0);
+    if(2*(table->nentries+1) > table->alloc) hashGrow(table);
+    for(slot=hashslot(table,entry->hash);table->table[slot] != NULL;slot=hashstep(table,slot));
+    table->table[slot] = entry;
+    table->nentries++;
+    if(table->ordered != NULL) skipInsert(table->ordered,entry);
+}
+
+/* Release the slots of the table; the entries
+   themselves must have been reclaimed by the caller.
+*/
+
+static void
+hashClear(struct HashTable* table)
+{
+    nullfree(table->table);
+    if(table->ordered != NULL) skipFree(table->ordered);
+    memset(table,0,sizeof(struct HashTable));
+}
+
+/* Keep an ordered index for the table from now on;
+   the entries already in the table are added to it.
 */
+static void
+hashOrder(struct HashTable* table)
+{
+    size_t slot;
+
+    if(table->ordered != NULL) return;
+    table->ordered = skipNew();
+    for(slot=0;slot<table->alloc;slot++) {
+	if(table->table[slot] != NULL) skipInsert(table->ordered,table->table[slot]);
+    }
+}
+
+/* Return the first node of the ordered index whose name is >= prefix;
+   follow node->next[0] to visit the rest in order.
+   The table must be ordered (see hashOrder).
+*/
+static struct SkipNode*
+hashFirst(struct HashTable* table, const char* prefix)
+{
+    assert(table->ordered != NULL);
+    if(prefix == NULL || *prefix == NUL8) return table->ordered->head->next[0];
+    return skipFind(table->ordered,prefix,NULL);
+}
+
+/**************************************************/
+/* Skiplist implementation of the ordered index */
+
+static struct SkipList*
+skipNew(void)
+{
+    struct SkipList* sl = (struct SkipList*)calloc(1,sizeof(struct SkipList));
+    assert(sl != NULL);
+    sl->head = (struct SkipNode*)calloc(1,sizeof(struct SkipNode)+(SKIPMAXLEVEL-1)*sizeof(struct SkipNode*));
+    assert(sl->head != NULL);
+    sl->level = 1;
+    sl->seed = FNV32BASIS;
+    return sl;
+}
 
 static void
-hashInsert(struct HashTable* table, struct HashEntry* prev, struct HashEntry* entry)
+skipFree(struct SkipList* sl)
 {
-   assert(table != NULL && prev != NULL && entry != NULL);
-   assert(entry->hash != 0);
-   entry->next = prev->next;
-   prev->next = entry;
-   table->nentries++;
+    struct SkipNode* node;
+    struct SkipNode* next;
+
+    for(node=sl->head->next[0];node != NULL;node=next) {
+	next = node->next[0];
+	free(node);
+    }
+    free(sl->head);
+    free(sl);
+}
+
+/* Choose a level for a new node: level k with probability (3/4)*(1/4)^(k-1) */
+static int
+skipLevel(struct SkipList* sl)
+{
+    unsigned x = sl->seed;
+    int level = 1;
+
+    /* xorshift32 */
+    x ^= (x << 13) & 0xFFFFFFFFU;
+    x ^= (x >> 17);
+    x ^= (x << 5) & 0xFFFFFFFFU;
+    sl->seed = x;
+    for(;level < SKIPMAXLEVEL && (x & 3) == 0;x >>= 2) level++;
+    return level;
+}
+
+/* Return the first node whose name is >= name.
+   If update is not NULL, then update[i] is set to the last
+   node at level i whose name is < name.
+*/
+static struct SkipNode*
+skipFind(struct SkipList* sl, const char* name, struct SkipNode** update)
+{
+    struct SkipNode* x = sl->head;
+    int i;
+
+    for(i=sl->level-1;i>=0;i--) {
+	while(x->next[i] != NULL && strcmp(x->next[i]->entry->name,name) < 0)
+	    x = x->next[i];
+	if(update != NULL) update[i] = x;
+    }
+    return x->next[0];
+}
+
+static void
+skipInsert(struct SkipList* sl, struct HashEntry* entry)
+{
+    struct SkipNode* update[SKIPMAXLEVEL];
+    struct SkipNode* node;
+    int i, level;
+
+    (void)skipFind(sl,entry->name,update);
+    level = skipLevel(sl);
+    for(;sl->level < level;sl->level++) update[sl->level] = sl->head;
+    node = (struct SkipNode*)malloc(sizeof(struct SkipNode)+(level-1)*sizeof(struct SkipNode*));
+    assert(node != NULL);
+    node->entry = entry;
+    for(i=0;i<level;i++) {
+	node->next[i] = update[i]->next[i];
+	update[i]->next[i] = node;
+    }
+}
+
+static void
+skipRemove(struct SkipList* sl, struct HashEntry* entry)
+{
+    struct SkipNode* update[SKIPMAXLEVEL];
+    struct SkipNode* node;
+    int i;
+
+    node = skipFind(sl,entry->name,update);
+    assert(node != NULL && node->entry == entry); /* validate the removal */
+    for(i=0;i<sl->level && update[i]->next[i] == node;i++)
+	update[i]->next[i] = node->next[i];
+    free(node);
+    while(sl->level > 1 && sl->head->next[sl->level-1] == NULL) sl->level--;
 }
 
 static void*
@@ -85,8 +321,7 @@ hashwalk(struct HashTable* table)
     if((walker = calloc(sizeof(struct HashWalk),1))==NULL) return NULL;
     assert(walker != NULL);
     walker->table = table;
-    walker->chain = 0;
-    walker->entry = walker->table->table[walker->chain].next;
+    walker->slot = 0;
     return (void*)walker;
 }
 
@@ -98,25 +333,28 @@ hashwalkstop(void* walkstate)
     }
 }
 
+/* Note that the current entry may be reclaimed by the caller,
+   but the table must not otherwise be modified during a walk.
+*/
 static int
 hashnext(void* walkstate, struct HashEntry** ithentryp)
 {
     struct HashWalk* walker = (struct HashWalk*)walkstate;
-    while(walker->entry == NULL) { /* Find next non-empty chain */
-	walker->chain++;
-	if(walker->chain >= HASHSIZE) return 0; /* No more chains to search */
-	walker->entry = walker->table->table[walker->chain].next;
+    struct HashTable* table = walker->table;
+    while(walker->slot < table->alloc) { /* Find next non-empty slot */
+	struct HashEntry* entry = table->table[walker->slot++];
+	if(entry != NULL) {
+	    if(ithentryp) *ithentryp = entry;
+	    return 1;
+	}
     }
-    if(ithentryp) *ithentryp = walker->entry;
-    walker->entry = walker->entry->next;
-    return 1;
+    return 0; /* No more slots to search */
 }
 
+/* Note that the name is owned by the atom table and is not freed */
 static void
 clearHashEntry(struct HashEntry* entry)
 {
     if(entry == NULL) return;
-    nullfree(entry->name);
     memset(entry,0,sizeof(struct HashEntry));
 }
-
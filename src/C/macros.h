@@ -9,8 +9,30 @@
 /**************************************************/
 /* The reason for these macros is to get around the fact that changing ttm->vs.active->index invalidates cp8 pointers */
 
-#define TTMCP8SET(ttm) do{cp8=vsindexp((ttm)->vs.active); ncp=u8size(cp8);}while(0)
-#define TTMCP8NXT(ttm) do{cp8=vsindexskip((ttm)->vs.active,u8size(cp8));ncp=u8size(cp8);}while(0)
+/* The pair (cp8,ncp) acts as a cursor over ttm->vs.active: cp8 points at
+   the current codepoint, ncp is its length, and ttm->vs.active->index is
+   kept in sync. These operate directly on the VString fields because
+   they are executed for every character scanned. */
+#define TTMCP8SET(ttm) do{cp8=(ttm)->vs.active->content+(ttm)->vs.active->index; ncp=U8SIZE(cp8);}while(0)
+#define TTMCP8NXT(ttm) do{\
+			VString* act = (ttm)->vs.active; \
+			act->index += (ncp > 0 ? (size_t)ncp : 1); \
+			if(act->index > act->length) act->index = act->length; \
+			cp8 = act->content+act->index; \
+			ncp = U8SIZE(cp8); \
+			}while(0)
+/* Copy the run of non-significant (per sigflags) bytes starting at cp8
+   from active to passive and move past it; always moves at least one codepoint */
+#define TTMCP8RUN(ttm,sigflags) do{\
+			VString* act = (ttm)->vs.active; \
+			size_t run = sigspan((ttm),cp8,act->length-act->index,(sigflags)); \
+			if(run == 0) run = (ncp > 0 ? (size_t)ncp : 1); \
+			vsindexappendn((ttm)->vs.passive,cp8,run); \
+			act->index += run; \
+			if(act->index > act->length) act->index = act->length; \
+			cp8 = act->content+act->index; \
+			ncp = U8SIZE(cp8); \
+			}while(0)
 #define TTMCP8BACK(ttm) do{\
 			char* p8 = vscontents((ttm)->vs.active); \
 			size_t newindex; \
@@ -49,6 +71,9 @@
 #define isescape(cp) u8equal(cp,ttm->meta.escapec)
 #define isascii8(cp) (*UTF8P(cp) <= 0x7F)
 
+/* Codepoint length via u8lentable, with the common ASCII case first */
+#define U8SIZE(cp) (UTF8P(cp)[0] < SEGMARK0 ? 1 : (int)u8lentable[UTF8P(cp)[0]])
+
 #define issegmark(cp8) ((UTF8P(cp8)[0]) == SEGMARK0)
 #define segmarkindex(cp8) (((((size_t)(UTF8P(cp8)[1])) & SEGMARKINDEXUNMASK) << SEGMARKINDEXSHIFT) | (((size_t)(UTF8P(cp8)[2])) & SEGMARKINDEXUNMASK))
 
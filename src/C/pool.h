@@ -0,0 +1,165 @@
+/**************************************************/
+/**
+Fixed size object pools.
+
+Functions, character classes, and properties are allocated
+from per-type pools (see TTM.pools) rather than one at a time
+from calloc. A pool carves its elements out of slabs holding
+POOLSLABSIZE elements each; freed elements go onto a free list
+and are re-used by the next poolalloc(), so programs that
+repeatedly create and erase names do not touch malloc at all.
+The slabs are released all at once by poolclear(), or
+individually by poolshrink() once all their elements are free.
+*/
+
+/**
+Initialize an empty pool.
+@param pool
+@param elemsize size of the objects in the pool
+@return void
+*/
+static void
+poolinit(struct Pool* pool, size_t elemsize)
+{
+    size_t unit = sizeof(union PoolSlab);
+    memset(pool,0,sizeof(struct Pool));
+    /* Round up so that every element is aligned like the slab header */
+    pool->elemsize = ((elemsize + unit - 1) / unit) * unit;
+}
+
+/**
+Get a zeroed element from the pool, adding a slab if necessary.
+@param pool
+@return the element or NULL if out of memory
+*/
+static void*
+poolalloc(struct Pool* pool)
+{
+    void* elem;
+
+    if(pool->freelist == NULL) {
+	union PoolSlab* slab;
+	char* base;
+	size_t i;
+	slab = (union PoolSlab*)malloc(sizeof(union PoolSlab) + POOLSLABSIZE*pool->elemsize);
+	if(slab == NULL) return NULL;
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	pool->nslabs++;
+	/* Thread the new elements onto the free list, first element first */
+	base = (char*)(slab+1);
+	for(i=POOLSLABSIZE;i-- > 0;) {
+	    void** e = (void**)(base + i*pool->elemsize);
+	    *e = pool->freelist;
+	    pool->freelist = (void*)e;
+	}
+    }
+    elem = pool->freelist;
+    pool->freelist = *(void**)elem;
+    memset(elem,0,pool->elemsize);
+    pool->inuse++;
+    pool->allocs++;
+    return elem;
+}
+
+/**
+Return an element to the pool.
+@param pool
+@param elem as returned by poolalloc()
+@return void
+*/
+static void
+poolfree(struct Pool* pool, void* elem)
+{
+    if(elem == NULL) return;
+    assert(pool->inuse > 0);
+    *(void**)elem = pool->freelist;
+    pool->freelist = elem;
+    pool->inuse--;
+}
+
+/**
+Release all the slabs of the pool at once; every element
+obtained from the pool becomes invalid. The pool remains
+usable afterwards.
+@param pool
+@return void
+*/
+static void
+poolclear(struct Pool* pool)
+{
+    while(pool->slabs != NULL) {
+	union PoolSlab* next = pool->slabs->next;
+	free(pool->slabs);
+	pool->slabs = next;
+    }
+    pool->freelist = NULL;
+    pool->inuse = 0;
+}
+
+/* Order slabs by address for poolshrink() */
+static int
+slabcmp(const void* a, const void* b)
+{
+    const char* sa = *(const char* const*)a;
+    const char* sb = *(const char* const*)b;
+    return (sa < sb ? -1 : (sa > sb ? 1 : 0));
+}
+
+/* Find the slab holding elem; slabv is sorted by address */
+static size_t
+slabof(union PoolSlab** slabv, size_t nslabs, const char* elem)
+{
+    size_t lo = 0, hi = nslabs; /* the slab is the last one that starts <= elem */
+    while(hi - lo > 1) {
+	size_t mid = (lo + hi) / 2;
+	if((const char*)slabv[mid] <= elem) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+/**
+Release the slabs none of whose elements are in use;
+the elements in use do not move.
+@param pool
+@return the no. of bytes given back
+*/
+static size_t
+poolshrink(struct Pool* pool)
+{
+    union PoolSlab** slabv = NULL;
+    size_t* nfree = NULL;
+    union PoolSlab* slab;
+    void** link;
+    size_t i, nslabs = 0, nreleased = 0;
+
+    if(pool->freelist == NULL) return 0;
+    for(slab=pool->slabs;slab != NULL;slab=slab->next) nslabs++;
+    slabv = (union PoolSlab**)malloc(nslabs*sizeof(union PoolSlab*));
+    nfree = (size_t*)calloc(nslabs,sizeof(size_t));
+    if(slabv == NULL || nfree == NULL) goto done; /* just do nothing */
+    for(i=0,slab=pool->slabs;slab != NULL;slab=slab->next) slabv[i++] = slab;
+    qsort(slabv,nslabs,sizeof(union PoolSlab*),slabcmp);
+
+    /* Count the free elements of each slab */
+    for(link=(void**)pool->freelist;link != NULL;link=(void**)*link)
+	nfree[slabof(slabv,nslabs,(const char*)link)]++;
+    /* Unthread the elements of the slabs to be released */
+    for(link=&pool->freelist;*link != NULL;) {
+	if(nfree[slabof(slabv,nslabs,(const char*)*link)] == POOLSLABSIZE)
+	    *link = *(void**)*link;
+	else
+	    link = (void**)*link;
+    }
+    /* Rebuild the slab list without them */
+    pool->slabs = NULL;
+    for(i=nslabs;i-- > 0;) {
+	if(nfree[i] == POOLSLABSIZE) {free(slabv[i]); nreleased++; continue;}
+	slabv[i]->next = pool->slabs;
+	pool->slabs = slabv[i];
+    }
+done:
+    nullfree(slabv);
+    nullfree(nfree);
+    return nreleased * (sizeof(union PoolSlab) + POOLSLABSIZE*pool->elemsize);
+}
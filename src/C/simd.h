@@ -0,0 +1,482 @@
+/**************************************************/
+/**
+Significant character detection.
+
+Most of the text seen by scan() and collectargs() is ordinary text
+that is just copied to the passive buffer. In order to copy it in
+runs rather than one codepoint at a time, ttm->sig.table records,
+for each byte value, the contexts (SIG_SCAN, SIG_ARG, SIG_BRC)
+in which that byte is significant. For a multi-byte meta character,
+only its first byte is marked, so a marked byte is only a candidate
+and must still be checked by the caller using u8equal.
+
+Since significant bytes are either ASCII or UTF-8 lead bytes,
+a run of non-significant bytes always ends on a codepoint boundary.
+
+If SSE2 or AVX2 is available (see HAVE_SSE2 and HAVE_AVX2 in ttm.c),
+then sigspan() uses vector compares to find candidate bytes 16 or 32
+bytes at a time and confirms them using the table.
+
+Character class matching (see compilecharclass) uses the same
+idea: classspan() skips the run of ASCII characters whose bits
+are set in the class bitmap. With AVX2, the bitmap is looked up
+32 bytes at a time using byte shuffles indexed by the low and
+high nibbles of each byte; SSE2 has no byte shuffle, so there
+the bitmap is tested a byte at a time.
+
+asciispan() finds the end of a run of plain ASCII, which lets
+buildcpindex() recognize an all ASCII body in one pass.
+
+UTF-8 text is validated, and its codepoints counted and skipped,
+a vector at a time by u8validspan(), u8count() and u8skip().
+Validation follows the rule used by ttmgetc8() and u8validcp():
+a lead byte (see u8lentable, where SEGMARK0 leads three bytes)
+must be followed by exactly the right no. of continuation bytes.
+So a byte must be a continuation byte if and only if one of the
+three bytes before it requires one; that is checked for a whole
+vector by comparing it with copies of itself loaded 1, 2 and 3
+bytes earlier (cf. the simdutf validators). Counting and skipping
+only need to recognize the bytes that are not continuation bytes.
+
+Substring search for #<scn> (see searchcompile) picks two bytes
+of the pattern, the one least likely to occur in text and one other,
+and uses vector compares to find the positions where both occur
+at the right distance; only those are compared in full.
+Without vector support, memchr() looks for the rarer byte.
+*/
+
+#if defined HAVE_AVX2
+typedef __m256i simdvec;
+#define SIMDWIDTH 32
+#define simdload(p) _mm256_loadu_si256((const __m256i*)(p))
+#define simdset1(c) _mm256_set1_epi8((char)(c))
+#define simdeq(a,b) _mm256_cmpeq_epi8(a,b)
+#define simdor(a,b) _mm256_or_si256(a,b)
+#define simdand(a,b) _mm256_and_si256(a,b)
+#define simdxor(a,b) _mm256_xor_si256(a,b)
+#define simdgt(a,b) _mm256_cmpgt_epi8(a,b)
+#define simdmaxu(a,b) _mm256_max_epu8(a,b)
+#define simdmask(v) ((unsigned)_mm256_movemask_epi8(v))
+#elif defined HAVE_SSE2
+typedef __m128i simdvec;
+#define SIMDWIDTH 16
+#define simdload(p) _mm_loadu_si128((const __m128i*)(p))
+#define simdset1(c) _mm_set1_epi8((char)(c))
+#define simdeq(a,b) _mm_cmpeq_epi8(a,b)
+#define simdor(a,b) _mm_or_si128(a,b)
+#define simdand(a,b) _mm_and_si128(a,b)
+#define simdxor(a,b) _mm_xor_si128(a,b)
+#define simdgt(a,b) _mm_cmpgt_epi8(a,b)
+#define simdmaxu(a,b) _mm_max_epu8(a,b)
+#define simdmask(v) ((unsigned)_mm_movemask_epi8(v))
+#endif
+
+#ifdef SIMDWIDTH
+#ifdef _MSC_VER
+static int
+simdctz(unsigned x)
+{
+    unsigned long i;
+    _BitScanForward(&i,x);
+    return (int)i;
+}
+/* __popcnt needs the POPCNT instruction, which SSE2 does not imply */
+static int
+simdpopcount(unsigned x)
+{
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    x = (x + (x >> 4)) & 0x0F0F0F0F;
+    return (int)((x * 0x01010101) >> 24);
+}
+#else
+#define simdctz(x) __builtin_ctz(x)
+#define simdpopcount(x) __builtin_popcount(x)
+#endif
+/* Bytes of v that are >= c, treating bytes as unsigned */
+#define simdgeu(v,c) simdeq(simdmaxu((v),simdset1(c)),(v))
+#endif /*SIMDWIDTH*/
+
+/**
+Mark the first byte of a meta character as significant.
+@param ttm
+@param cp8 the meta character
+@param flags SIG_XXX contexts in which it is significant
+@return void
+*/
+static void
+sigmeta(TTM* ttm, const char* cp8, int flags)
+{
+    utf8 b = UTF8P(cp8)[0];
+    int i;
+
+    ttm->sig.table[b] |= (utf8)flags;
+    for(i=0;i<ttm->sig.nmetabytes;i++) {
+	if(ttm->sig.metabytes[i] == b) return;
+    }
+    ttm->sig.metabytes[ttm->sig.nmetabytes++] = b;
+}
+
+/**
+(Re-)build the significance table from ttm->meta.
+Must be called whenever a meta character changes.
+@param ttm
+@return void
+*/
+static void
+buildsigtable(TTM* ttm)
+{
+    const char* p;
+
+    memset(ttm->sig.table,0,sizeof(ttm->sig.table));
+    ttm->sig.nmetabytes = 0;
+    ttm->sig.table[NUL8] = SIG_ALL; /* always stop at end of buffer */
+    for(p=NPIDEPTH0;*p;p++)
+	ttm->sig.table[UTF8(*p)] |= SIG_SCAN;
+    sigmeta(ttm,ttm->meta.escapec,SIG_ALL);
+    sigmeta(ttm,ttm->meta.sharpc,SIG_SCAN|SIG_ARG);
+    sigmeta(ttm,ttm->meta.semic,SIG_ARG);
+    sigmeta(ttm,ttm->meta.closec,SIG_ARG);
+    sigmeta(ttm,ttm->meta.lbrc,SIG_ALL);
+    sigmeta(ttm,ttm->meta.rbrc,SIG_BRC);
+}
+
+/**
+Compute the length of the longest prefix of s8 that
+contains no byte significant in any of the contexts in flags.
+@param ttm
+@param s8 string to check
+@param len max no. of bytes to check
+@param flags SIG_XXX contexts of interest
+@return length of the run in bytes (<= len)
+*/
+static size_t
+sigspan(TTM* ttm, const char* s8, size_t len, int flags)
+{
+    const utf8* p = UTF8P(s8);
+    const utf8* end = p + len;
+    const utf8* table = ttm->sig.table;
+
+#ifdef SIMDWIDTH
+    /* Runs are often short, so check the first few bytes before
+       paying for the vector setup */
+    {
+	const utf8* pre = (len < SIMDWIDTH ? end : p + SIMDWIDTH);
+	for(;p < pre;p++) {
+	    if(table[*p] & flags) return (size_t)(p - UTF8P(s8));
+	}
+    }
+    if(p + SIMDWIDTH <= end) {
+	simdvec metav[sizeof(ttm->sig.metabytes)];
+	simdvec zero = simdset1(0);
+	simdvec ctl = simdset1(0x1F);
+	simdvec del = simdset1(0x7F);
+	int i, nmeta = ttm->sig.nmetabytes;
+	int scanctx = ((flags & SIG_SCAN) != 0);
+
+	for(i=0;i<nmeta;i++) metav[i] = simdset1(ttm->sig.metabytes[i]);
+	for(;p + SIMDWIDTH <= end;p += SIMDWIDTH) {
+	    simdvec v = simdload(p);
+	    simdvec hits = simdeq(v,zero);
+	    unsigned bits;
+	    if(scanctx) { /* v <= 0x1F || v == 0x7F */
+		hits = simdor(hits,simdeq(simdmaxu(v,ctl),ctl));
+		hits = simdor(hits,simdeq(v,del));
+	    }
+	    for(i=0;i<nmeta;i++) hits = simdor(hits,simdeq(v,metav[i]));
+	    /* confirm the candidates */
+	    for(bits=simdmask(hits);bits != 0;bits &= (bits - 1)) {
+		const utf8* q = p + simdctz(bits);
+		if(table[*q] & flags) return (size_t)(q - UTF8P(s8));
+	    }
+	}
+    }
+#endif /*SIMDWIDTH*/
+    for(;p < end;p++) {
+	if(table[*p] & flags) break;
+    }
+    return (size_t)(p - UTF8P(s8));
+}
+
+/**
+Compute the length of the longest prefix of s8 in which every
+byte is a codepoint by itself: no NUL, no segment|create mark
+and no byte of a multi-byte codepoint.
+@param s8 string to check
+@param len max no. of bytes to check
+@return length of the run in bytes (<= len)
+*/
+static size_t
+asciispan(const char* s8, size_t len)
+{
+    const utf8* p = UTF8P(s8);
+    const utf8* end = p + len;
+
+#ifdef SIMDWIDTH
+    if(len >= SIMDWIDTH) {
+	simdvec zero = simdset1(0);
+	simdvec del = simdset1(SEGMARK0);
+	for(;p + SIMDWIDTH <= end;p += SIMDWIDTH) {
+	    simdvec v = simdload(p);
+	    /* the mask picks up the high bit of each byte directly */
+	    unsigned stop = simdmask(simdor(v,simdor(simdeq(v,zero),simdeq(v,del))));
+	    if(stop != 0) return (size_t)((p + simdctz(stop)) - UTF8P(s8));
+	}
+    }
+#endif /*SIMDWIDTH*/
+    for(;p < end;p++) {
+	if(*p == 0 || *p >= SEGMARK0) break;
+    }
+    return (size_t)(p - UTF8P(s8));
+}
+
+/**
+Compute the length of the longest prefix of s8 that is a sequence
+of whole, valid codepoints (see u8validcp).
+@param s8 string to check
+@param len no. of bytes to check
+@return length of the valid prefix in bytes (<= len); a codepoint
+cut off by the end of s8 is not part of it
+*/
+static size_t
+u8validspan(const char* s8, size_t len)
+{
+    const utf8* s = UTF8P(s8);
+    const utf8* p = s;
+    const utf8* end = s + len;
+
+    for(;;) {
+	int n;
+#ifdef SIMDWIDTH
+	/* The vector loop needs the three (valid) bytes before p; after it
+	   stops, the codepoint it stopped in is checked bytewise below */
+	if(p - s >= 3 && p + SIMDWIDTH <= end) {
+	    const utf8* start = p;
+	    simdvec cmask = simdset1(0xC0);
+	    simdvec cbits = simdset1(0x80);
+	    simdvec mark = simdset1(SEGMARK0);
+	    for(;p + SIMDWIDTH <= end;p += SIMDWIDTH) {
+		simdvec v = simdload(p);
+		simdvec prev1 = simdload(p-1);
+		simdvec prev2 = simdload(p-2);
+		simdvec prev3 = simdload(p-3);
+		simdvec iscont = simdeq(simdand(v,cmask),cbits);
+		simdvec needcont = simdor(simdor(simdgeu(prev1,0xC0),simdgeu(prev2,0xE0)),
+					  simdor(simdgeu(prev3,0xF0),
+						 simdor(simdeq(prev1,mark),simdeq(prev2,mark))));
+		simdvec bad = simdor(simdxor(iscont,needcont),simdgeu(v,0xF8));
+		if(simdmask(bad) != 0) break;
+	    }
+	    /* Back up to the start of the codepoint containing p[-1],
+	       which may be cut off by the error or by the end */
+	    if(p > start) {for(p--;(*p & 0xC0) == 0x80;p--);}
+	}
+#endif /*SIMDWIDTH*/
+	if(p >= end) break;
+	n = u8lentable[*p];
+	if(n <= 0 || (size_t)(end - p) < (size_t)n) break;
+	switch (n) { /* check the continuation bytes */
+	case 4: if((p[3] & 0xC0) != 0x80) goto done; /* fall thru */
+	case 3: if((p[2] & 0xC0) != 0x80) goto done; /* fall thru */
+	case 2: if((p[1] & 0xC0) != 0x80) goto done; /* fall thru */
+	default: break;
+	}
+	p += n;
+    }
+done:
+    return (size_t)(p - s);
+}
+
+/**
+Count the codepoints in valid UTF-8 text; a segment|create
+mark counts as one codepoint (cf. strsubcp).
+@param s8 text
+@param len no. of bytes of text
+@return no. of codepoints
+*/
+static size_t
+u8count(const char* s8, size_t len)
+{
+    const utf8* p = UTF8P(s8);
+    const utf8* end = p + len;
+    size_t count = 0;
+
+#ifdef SIMDWIDTH
+    {
+	/* As signed bytes, the continuation bytes are -128..-65 */
+	simdvec lastcont = simdset1(0xBF);
+	for(;p + SIMDWIDTH <= end;p += SIMDWIDTH)
+	    count += (size_t)simdpopcount(simdmask(simdgt(simdload(p),lastcont)));
+    }
+#endif /*SIMDWIDTH*/
+    for(;p < end;p++) {
+	if((*p & 0xC0) != 0x80) count++;
+    }
+    return count;
+}
+
+/**
+Find the byte offset of codepoint n of valid UTF-8 text.
+@param s8 text
+@param len no. of bytes of text
+@param n codepoint offset
+@return byte offset of codepoint n, or len if the text
+has no more than n codepoints
+*/
+static size_t
+u8skip(const char* s8, size_t len, size_t n)
+{
+    const utf8* s = UTF8P(s8);
+    const utf8* p = s;
+    const utf8* end = s + len;
+
+#ifdef SIMDWIDTH
+    {
+	simdvec lastcont = simdset1(0xBF);
+	for(;p + SIMDWIDTH <= end;p += SIMDWIDTH) {
+	    unsigned leads = simdmask(simdgt(simdload(p),lastcont));
+	    size_t nleads = (size_t)simdpopcount(leads);
+	    if(n < nleads) { /* drop the first n leads; the next one is it */
+		for(;n > 0;n--) leads &= (leads - 1);
+		return (size_t)((p + simdctz(leads)) - s);
+	    }
+	    n -= nleads;
+	}
+    }
+#endif /*SIMDWIDTH*/
+    for(;p < end;p++) {
+	if((*p & 0xC0) == 0x80) continue;
+	if(n == 0) break;
+	n--;
+    }
+    return (size_t)(p - s);
+}
+
+/**
+Compute the length of the longest prefix of s8 consisting of
+ASCII characters that match the class (see compilecharclass).
+@param cl compiled class
+@param s8 string to check
+@param len max no. of bytes to check
+@return length of the run in bytes (<= len)
+*/
+static size_t
+classspan(const Charclass* cl, const char* s8, size_t len)
+{
+    const utf8* p = UTF8P(s8);
+    const utf8* end = p + len;
+    const utf8* ascii = cl->ascii;
+
+#ifdef HAVE_AVX2
+    if(len >= SIMDWIDTH) {
+	/* ascii[lo] holds the bits for the characters hi*16+lo, hi=0..7;
+	   bytes >= 0x80 select a zero bit and so never match */
+	simdvec table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)ascii));
+	simdvec hibit = _mm256_setr_epi8(1,2,4,8,16,32,64,(char)128,0,0,0,0,0,0,0,0,
+					 1,2,4,8,16,32,64,(char)128,0,0,0,0,0,0,0,0);
+	simdvec nibble = simdset1(0x0F);
+	simdvec zero = simdset1(0);
+	for(;p + SIMDWIDTH <= end;p += SIMDWIDTH) {
+	    simdvec v = simdload(p);
+	    simdvec lo = _mm256_and_si256(v,nibble);
+	    simdvec hi = _mm256_and_si256(_mm256_srli_epi16(v,4),nibble);
+	    simdvec bits = _mm256_and_si256(_mm256_shuffle_epi8(table,lo),_mm256_shuffle_epi8(hibit,hi));
+	    unsigned miss = simdmask(simdeq(bits,zero));
+	    if(miss != 0) return (size_t)((p + simdctz(miss)) - UTF8P(s8));
+	}
+    }
+#endif /*HAVE_AVX2*/
+    for(;p < end;p++) {
+	if(*p >= 0x80 || (ascii[*p & 0xF] & (1 << (*p >> 4))) == 0) break;
+    }
+    return (size_t)(p - UTF8P(s8));
+}
+
+/**
+Estimate how common a byte is in typical text;
+used to choose the byte that searchfind() looks for.
+@param c
+@return larger => more common
+*/
+static int
+byterank(utf8 c)
+{
+    if(c == ' ') return 255;
+    if(c >= 0x80) return 120; /* part of a non-ASCII codepoint */
+    if(c >= 'a' && c <= 'z') return (strchr("etaoinsrhldcu",c) != NULL ? 220 : 180);
+    if(c >= 'A' && c <= 'Z') return 130;
+    if(c >= '0' && c <= '9') return 140;
+    if(c == '\n' || c == ',' || c == '.') return 150;
+    if(c < ' ') return 20;
+    return 60; /* other punctuation */
+}
+
+/**
+Compile a pattern for searchfind().
+@param s the searcher to fill in
+@param pattern; must stay valid while s is in use
+@param plen strlen(pattern)
+@param hash computehashn(pattern,plen)
+@return void
+*/
+static void
+searchcompile(struct Searcher* s, const char* pattern, size_t plen, unsigned hash)
+{
+    size_t i;
+
+    s->pattern = pattern;
+    s->plen = plen;
+    s->hash = hash;
+    s->rare = 0;
+    for(i=1;i<plen;i++) {
+	if(byterank(UTF8(pattern[i])) < byterank(UTF8(pattern[s->rare]))) s->rare = i;
+    }
+    /* Filter on the last byte too, or the first if the last is the rarest */
+    s->other = (s->rare == plen - 1 ? 0 : plen - 1);
+    if(plen == 0) s->other = 0;
+}
+
+/**
+Find the first occurrence of a compiled pattern in text, like strstr.
+@param s compiled pattern
+@param text to search; need not be nul terminated
+@param tlen length of text in bytes
+@return ptr to the first occurrence or NULL if none
+*/
+static const char*
+searchfind(const struct Searcher* s, const char* text, size_t tlen)
+{
+    const char* pat = s->pattern;
+    size_t plen = s->plen;
+    size_t i = 0;
+
+    if(plen == 0) return text;
+    if(plen > tlen) return NULL;
+    if(plen == 1) return (const char*)memchr(text,*pat,tlen);
+#ifdef SIMDWIDTH
+    {
+	/* Candidate i has pat[rare] at text[i+rare] and pat[other] at text[i+other] */
+	simdvec rarev = simdset1(pat[s->rare]);
+	simdvec otherv = simdset1(pat[s->other]);
+	size_t hi = (s->rare > s->other ? s->rare : s->other);
+	for(;i + hi + SIMDWIDTH <= tlen;i += SIMDWIDTH) {
+	    simdvec r = simdeq(simdload(text + i + s->rare),rarev);
+	    simdvec o = simdeq(simdload(text + i + s->other),otherv);
+	    unsigned bits;
+	    for(bits=simdmask(simdand(r,o));bits != 0;bits &= (bits - 1)) {
+		size_t at = i + (size_t)simdctz(bits); /* at + plen <= tlen since hi == plen-1 */
+		if(memcmp(text + at,pat,plen) == 0) return text + at;
+	    }
+	}
+    }
+#endif /*SIMDWIDTH*/
+    /* Look for the rare byte; then compare in full */
+    while(i + plen <= tlen) {
+	const char* q = (const char*)memchr(text + i + s->rare,pat[s->rare],tlen - plen - i + 1);
+	if(q == NULL) break;
+	i = (size_t)(q - text) - s->rare;
+	if(memcmp(text + i,pat,plen) == 0) return text + i;
+	i++;
+    }
+    return NULL;
+}
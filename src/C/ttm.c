@@ -31,6 +31,9 @@ This is in lieu of the typical config.h.
 /* Define if the equivalent of the standard Unix memmove() is available */
 #define HAVE_MEMMOVE
 
+/* Define to disable use of SSE2/AVX2 intrinsics (see simd.h) */
+#undef NOSIMD
+
 /**************************************************/
 
 /* It is not clear what the correct Windows CPP Tag should be.
@@ -70,6 +73,16 @@ This is in lieu of the typical config.h.
 #include <wctype.h>
 #endif /*!MSWINDOWS*/
 
+#ifndef NOSIMD
+#if defined __AVX2__
+#include <immintrin.h>
+#define HAVE_AVX2
+#elif defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAVE_SSE2
+#endif
+#endif /*!NOSIMD*/
+
 /**************************************************/
 /* Unix/Linux versus Windows Definitions */
 
@@ -99,9 +112,12 @@ static int getopt(int argc, char** argv, char* optstring);
 #include "macros.h"
 #include "forward.h"
 #include "hash.h"
+#include "pool.h"
 #include "va.h"
+#include "gc.h"
 #include "io.h"
 #include "utf8.h"
+#include "simd.h"
 #include "debug.h"
 #include "builtins.h"
 
@@ -110,46 +126,225 @@ static int getopt(int argc, char** argv, char* optstring);
 
 static Function*
 dictionaryLookup(TTM* ttm, const char* name)
+{
+    return dictionaryLookupHash(ttm,name,computehash(name));
+}
+
+/* Lookup with a precomputed hash; see Frame.namehash */
+static Function*
+dictionaryLookupHash(TTM* ttm, const char* name, unsigned hash)
 {
     struct HashTable* table = &ttm->tables.dictionary;
-    struct HashEntry* prev;
     struct HashEntry* entry;
     Function* def = NULL;
 
-    if(hashLocate(table,name,&prev)) {
-	entry = prev->next;
+    /* Local names shadow the dictionary */
+    if(ttm->frames.nlocals > 0 && (def = localLookup(ttm,name,hash)) != NULL)
+	return def;
+    if(hashLocateHash(table,name,hash,&entry)) {
 	def = (Function*)entry;
     } /*else Not found */
     return def;
 }
 
+/**
+Lookup a function for exec() using the call cache.
+The cache is direct mapped by hash, and every entry is
+invalidated whenever the dictionary changes (see the
+uses of callcache.generation).
+@param ttm
+@param name of the function
+@param hash computehash(name)
+@return the function or NULL if not defined
+*/
+static Function*
+callcacheLookup(TTM* ttm, const char* name, unsigned hash)
+{
+    struct CallCacheEntry* ce = &ttm->callcache.entries[hash & (CALLCACHESIZE-1)];
+    Function* fcn;
+
+    if(ce->fcn != NULL && ce->hash == hash
+       && ce->generation == ttm->callcache.generation
+       && strcmp(name,ce->fcn->entry.name)==0) {
+	ttm->callcache.hits++;
+	return ce->fcn;
+    }
+    ttm->callcache.misses++;
+    fcn = dictionaryLookupHash(ttm,name,hash);
+    if(fcn != NULL) {
+	ce->generation = ttm->callcache.generation;
+	ce->hash = hash;
+	ce->fcn = fcn;
+    }
+    return fcn;
+}
+
+/**
+Get the compiled searcher for a pattern, compiling it if it
+is not one of the SEARCHCACHESIZE most recently used ones.
+@param ttm
+@param pattern
+@param plen strlen(pattern)
+@return the searcher; valid until the next call
+*/
+static const struct Searcher*
+searcherLookup(TTM* ttm, const char* pattern, size_t plen)
+{
+    struct SearchCache* cache = &ttm->searchcache;
+    struct Searcher* lru = &cache->entries[0];
+    unsigned hash = computehashn(pattern,plen);
+    int i;
+
+    cache->clock++;
+    if(plen > SEARCHPATMAX) { /* too long to keep */
+	cache->misses++;
+	searchcompile(&cache->uncached,pattern,plen,hash);
+	return &cache->uncached;
+    }
+    for(i=0;i<SEARCHCACHESIZE;i++) {
+	struct Searcher* s = &cache->entries[i];
+	if(s->lastuse != 0 && s->hash == hash && s->plen == plen
+	   && memcmp(s->pattern,pattern,plen) == 0) {
+	    cache->hits++;
+	    s->lastuse = cache->clock;
+	    return s;
+	}
+	if(s->lastuse < lru->lastuse) lru = s;
+    }
+    cache->misses++;
+    memcpy(lru->copy,pattern,plen);
+    lru->copy[plen] = NUL8;
+    searchcompile(lru,lru->copy,plen,hash);
+    lru->lastuse = cache->clock;
+    return lru;
+}
+
 static Function*
 dictionaryRemove(TTM* ttm, const char* name)
 {
     struct HashTable* table = &ttm->tables.dictionary;
-    struct HashEntry* prev;
     struct HashEntry* entry;
     Function* def = NULL;
 
-    if(hashLocate(table,name,&prev)) {
-	entry = prev->next;
-	hashRemove(table,prev,entry);
-	entry->next = NULL;
+    if(ttm->frames.nlocals > 0 && (def = localRemove(ttm,name)) != NULL)
+	return def;
+    if(hashLocate(table,name,&entry)) {
 	def = (Function*)entry;
+	globalRemove(ttm,def);
     } /*else Not found */
     return def;
 }
 
+/**
+Remove a function from the dictionary proper, ignoring any
+local name that shadows it.
+@param ttm
+@param def a function in the dictionary
+@return void
+*/
+static void
+globalRemove(TTM* ttm, Function* def)
+{
+    hashRemove(&ttm->tables.dictionary,&def->entry);
+    ttm->callcache.generation++;
+}
+
+/**************************************************/
+/* Local names; see #<dl>.
+   Each frame keeps the names defined for it in a short list,
+   searched (innermost frame first) before the dictionary.
+   Since only a few names are expected per frame, a list is
+   cheaper than a table to build, search and discard. */
+
+/**
+Find a local name in any active frame.
+@param ttm
+@param name
+@param hash computehash(name)
+@return the function or NULL if there is no such local name
+*/
+static Function*
+localLookup(TTM* ttm, const char* name, unsigned hash)
+{
+    int i;
+    for(i=ttm->frames.top;i>=0;i--) {
+	Function* f;
+	for(f=ttm->frames.stack[i]->locals;f != NULL;f=f->nextlocal) {
+	    if(f->entry.hash == hash && strcmp(f->entry.name,name)==0) return f;
+	}
+    }
+    return NULL;
+}
+
+/**
+Add a local name to a frame; the caller ensures that
+the frame does not already have a local of that name.
+@param ttm
+@param frame to own the name
+@param fcn to add
+@return void
+*/
+static void
+localInsert(TTM* ttm, Frame* frame, Function* fcn)
+{
+    fcn->nextlocal = frame->locals;
+    frame->locals = fcn;
+    ttm->frames.nlocals++;
+    ttm->callcache.generation++;
+}
+
+/**
+Remove the innermost local with a given name.
+@param ttm
+@param name
+@return the removed function or NULL if there is no such local name
+*/
+static Function*
+localRemove(TTM* ttm, const char* name)
+{
+    int i;
+    for(i=ttm->frames.top;i>=0;i--) {
+	Function** fp;
+	for(fp=&ttm->frames.stack[i]->locals;*fp != NULL;fp=&(*fp)->nextlocal) {
+	    Function* f = *fp;
+	    if(strcmp(f->entry.name,name)==0) {
+		*fp = f->nextlocal;
+		f->nextlocal = NULL;
+		ttm->frames.nlocals--;
+		ttm->callcache.generation++;
+		return f;
+	    }
+	}
+    }
+    return NULL;
+}
+
+/**
+Free all the local names of a frame.
+@param ttm
+@param frame
+@return void
+*/
+static void
+clearLocals(TTM* ttm, Frame* frame)
+{
+    while(frame->locals != NULL) {
+	Function* f = frame->locals;
+	frame->locals = f->nextlocal;
+	ttm->frames.nlocals--;
+	freeFunction(ttm,f); /* also invalidates the call cache */
+    }
+}
+
 static int
 dictionaryInsert(TTM* ttm, Function* fcn)
 {
     struct HashTable* table = &ttm->tables.dictionary;
-    struct HashEntry* prev;
 
-    if(hashLocate(table,fcn->entry.name,&prev)) return 0;
+    if(hashLocateHash(table,fcn->entry.name,fcn->entry.hash,NULL)) return 0;
     /* Does not already exist */
-    fcn->entry.hash = computehash(fcn->entry.name);/*make sure*/
-    hashInsert(table,prev,(struct HashEntry*)fcn);
+    hashInsert(table,(struct HashEntry*)fcn);
+    ttm->callcache.generation++;
     return 1;
 }
 
@@ -157,12 +352,10 @@ static Charclass*
 charclassLookup(TTM* ttm, const char* name)
 {
     struct HashTable* table = &ttm->tables.charclasses;
-    struct HashEntry* prev;
     struct HashEntry* entry;
     Charclass* def = NULL;
 
-    if(hashLocate(table,name,&prev)) {
-	entry = prev->next;
+    if(hashLocate(table,name,&entry)) {
 	def = (Charclass*)entry;
     } /*else Not found */
     return def;
@@ -172,14 +365,11 @@ static Charclass*
 charclassRemove(TTM* ttm, const char* name)
 {
     struct HashTable* table = &ttm->tables.charclasses;
-    struct HashEntry* prev;
     struct HashEntry* entry;
     Charclass* def = NULL;
 
-    if(hashLocate(table,name,&prev)) {
-	entry = prev->next;
-	hashRemove(table,prev,entry);
-	entry->next = NULL;
+    if(hashLocate(table,name,&entry)) {
+	hashRemove(table,entry);
 	def = (Charclass*)entry;
     } /*else Not found */
     return def;
@@ -189,23 +379,111 @@ static int
 charclassInsert(TTM* ttm, Charclass* cl)
 {
     struct HashTable* table = &ttm->tables.charclasses;
-    struct HashEntry* prev;
-    if(hashLocate(table,cl->entry.name,&prev))
+    if(hashLocateHash(table,cl->entry.name,cl->entry.hash,NULL))
 	return 0;
     /* Not already exists */
-    cl->entry.hash = computehash(cl->entry.name);
-    hashInsert(table,prev,(struct HashEntry*)cl);
+    hashInsert(table,(struct HashEntry*)cl);
     return 1;
 }
 
+/**
+Return the unique copy (atom) of a name, creating it if necessary.
+Each call takes a reference to the atom that the caller
+gives back with releaseatom() when its entry is freed.
+@param ttm
+@param name
+@param hash computehash(name)
+@return the atom for name
+*/
+static char*
+intern(TTM* ttm, const char* name, unsigned hash)
+{
+    struct HashTable* table = &ttm->tables.atoms;
+    struct HashEntry* entry;
+    Atom* atom;
+
+    if(hashLocateHash(table,name,hash,&entry)) {
+	((Atom*)entry)->refcount++;
+	return entry->name;
+    }
+    atom = (Atom*)calloc(1,sizeof(Atom));
+    if(atom == NULL) FAIL(ttm,TTM_EMEMORY);
+    atom->entry.name = strdup(name);
+    atom->entry.hash = hash;
+    atom->refcount = 1;
+    hashInsert(table,(struct HashEntry*)atom);
+    return atom->entry.name;
+}
+
+/**
+As intern(), but if the name is not yet an atom, then
+the name itself is made the atom using the caller supplied
+storage; neither the atom nor the name is ever freed.
+Used for the names of the builtins.
+@param ttm
+@param name a static string
+@param hash computehash(name)
+@param atom storage for the atom
+@return the atom for name
+*/
+static char*
+internstatic(TTM* ttm, const char* name, unsigned hash, Atom* atom)
+{
+    struct HashTable* table = &ttm->tables.atoms;
+    struct HashEntry* entry;
+
+    if(hashLocateHash(table,name,hash,&entry)) return entry->name;
+    atom->entry.name = (char*)name;
+    atom->entry.hash = hash;
+    atom->isstatic = 1;
+    hashInsert(table,(struct HashEntry*)atom);
+    return atom->entry.name;
+}
+
+/**
+Give back a reference taken by intern() and free the
+atom once no function, class, property or local uses it.
+@param ttm
+@param name the atom
+@param hash computehash(name)
+@return void
+*/
+static void
+releaseatom(TTM* ttm, char* name, unsigned hash)
+{
+    struct HashTable* table = &ttm->tables.atoms;
+    struct HashEntry* entry;
+
+    if(!hashLocateHash(table,name,hash,&entry)) return;
+    if(((Atom*)entry)->isstatic) return;
+    if(--((Atom*)entry)->refcount > 0) return;
+    hashRemove(table,entry);
+    nullfree(entry->name);
+    free(entry);
+}
+
+static void
+clearatoms(TTM* ttm, struct HashTable* atoms)
+{
+    void* walker = hashwalk(atoms);
+    struct HashEntry* entry = NULL;
+    while(hashnext(walker,&entry)) {
+	if(((Atom*)entry)->isstatic) continue;
+	nullfree(entry->name);
+	free(entry);
+    }
+    hashwalkstop(walker);
+    hashClear(atoms);
+}
+
 static Property*
 newProperty(TTM* ttm, const char* key)
 {
-    Property* f = (Property*)calloc(1,sizeof(Property));
+    Property* f = (Property*)poolalloc(&ttm->pools.properties);
     if(f == NULL) FAIL(ttm,TTM_EMEMORY);
     assert(f->entry.name == NULL);
-    f->entry.name = strdup(key);
     f->entry.hash = computehash(key);
+    f->entry.name = intern(ttm,key,f->entry.hash);
     return f;
 }
 
@@ -214,37 +492,31 @@ freeProperty(TTM* ttm, Property* f)
 {
     assert(f != NULL);
     nullfree(f->value);
+    releaseatom(ttm,f->entry.name,f->entry.hash);
     clearHashEntry(&f->entry);
-    free(f);
+    poolfree(&ttm->pools.properties,f);
 }
 
 static void
 clearproperties(TTM* ttm, struct HashTable* props)
 {
-    size_t i;
-    for(i=0;i<HASHSIZE;i++) {
-	struct HashEntry* cur = props->table[i].next; /* First entry is a placeholder */
-	while(cur != NULL) {
-	    struct HashEntry* next = cur->next;
-	    struct Property* p = (struct Property*)cur;
-	    freeProperty(ttm,p);
-	    cur = next;
-	}
-	props->table[i].next = NULL;
-    }
-    memset(props,0,sizeof(struct HashTable));
+    void* walker = hashwalk(props);
+    struct HashEntry* entry = NULL;
+    while(hashnext(walker,&entry))
+	nullfree(((struct Property*)entry)->value);
+    hashwalkstop(walker);
+    hashClear(props);
+    poolclear(&ttm->pools.properties); /* reclaim the properties themselves */
 }
 
 static const char*
 propertyLookup(TTM* ttm, const char* key)
 {
     struct HashTable* table = &ttm->tables.properties;
-    struct HashEntry* prev;
     struct HashEntry* entry;
     const char* value = NULL;
 
-    if(hashLocate(table,key,&prev)) {
-	entry = prev->next;
+    if(hashLocate(table,key,&entry)) {
 	value = ((Property*)entry)->value;
     } /*else Not found */
     return value;
@@ -254,14 +526,11 @@ static Property*
 propertyRemove(TTM* ttm, const char* key)
 {
     struct HashTable* table = &ttm->tables.properties;
-    struct HashEntry* prev;
     struct HashEntry* entry;
     Property* prop = NULL;
 
-    if(hashLocate(table,key,&prev)) {
-	entry = prev->next;
-	hashRemove(table,prev,entry);
-	entry->next = NULL;
+    if(hashLocate(table,key,&entry)) {
+	hashRemove(table,entry);
 	prop = (Property*)entry;
     } /*else Not found */
     return prop;
@@ -271,14 +540,14 @@ static int
 propertyInsert(TTM* ttm, const char* key, const char* value)
 {
     struct HashTable* table = &ttm->tables.properties;
-    struct HashEntry* prev;
+    struct HashEntry* entry;
     Property* prop = NULL;
 
-    if(!hashLocate(table,key,&prev)) { /* Not already exists */
+    if(!hashLocate(table,key,&entry)) { /* Not already exists */
         prop = newProperty(ttm,key);
-	hashInsert(table,prev,(struct HashEntry*)prop);
+	hashInsert(table,(struct HashEntry*)prop);
     } else {
-	prop = (Property*)prev->next;
+	prop = (Property*)entry;
     }
     nullfree(prop->value);
     prop->value = (char*)nulldup(value);
@@ -304,15 +573,25 @@ newTTM(struct Properties* initialprops)
        2. IO escape -- this is the escape character used to escape input/output characterss; normally '\\'.
     */
     ascii2u8('@',ttm->meta.escapec);
+    buildsigtable(ttm);
 
     ttm->vs.active = vsnew();
     ttm->vs.passive = vsnew();
     ttm->vs.tmp = vsnew();
     ttm->vs.result = vsnew();
     ttm->frames.top = -1;
+    ttm->frames.maxtop = -1;
     memset((void*)&ttm->tables.dictionary,0,sizeof(ttm->tables.dictionary));
     memset((void*)&ttm->tables.charclasses,0,sizeof(ttm->tables.charclasses));
     memset((void*)&ttm->tables.properties,0,sizeof(ttm->tables.properties));
+    memset((void*)&ttm->tables.atoms,0,sizeof(ttm->tables.atoms));
+    /* Keep the names in order for #<names>, #<classes>, etc. */
+    hashOrder(&ttm->tables.dictionary);
+    hashOrder(&ttm->tables.charclasses);
+    hashOrder(&ttm->tables.properties);
+    poolinit(&ttm->pools.functions,sizeof(Function));
+    poolinit(&ttm->pools.charclasses,sizeof(Charclass));
+    poolinit(&ttm->pools.properties,sizeof(Property));
 #if DEBUG > 0
     ttm->debug.trace = TR_UNDEF;
 #endif
@@ -334,6 +613,9 @@ freeTTM(TTM* ttm)
     clearDictionary(ttm,&ttm->tables.dictionary);
     clearcharclasses(ttm,&ttm->tables.charclasses);
     clearproperties(ttm,&ttm->tables.properties);
+    clearatoms(ttm,&ttm->tables.atoms);
+    nullfree(ttm->builtins.functions);
+    nullfree(ttm->builtins.atoms);
     closeio(ttm);
     nullfree(ttm->opts.programfilename);
     free(ttm);
@@ -349,10 +631,31 @@ pushFrame(TTM* ttm)
     ttm->frames.top++;
     if(ttm->frames.top >= (int)ttm->properties.stacksize)
 	FAIL(ttm,TTM_ESTACKOVERFLOW);
-    frame = &ttm->frames.stack[ttm->frames.top];
+    if(ttm->frames.top > ttm->frames.maxtop) ttm->frames.maxtop = ttm->frames.top;
+    if((size_t)ttm->frames.top >= ttm->frames.alloc) {
+	/* Only the pointer vector moves, so outstanding Frame* stay valid */
+	size_t newalloc = (ttm->frames.alloc == 0 ? FRAMESTACK0 : 2*ttm->frames.alloc);
+	Frame** newstack = (Frame**)calloc(newalloc,sizeof(Frame*));
+	if(newstack == NULL) FAIL(ttm,TTM_EMEMORY);
+	if(ttm->frames.stack != NULL)
+	    memcpy(newstack,ttm->frames.stack,ttm->frames.alloc*sizeof(Frame*));
+	nullfree(ttm->frames.stack);
+	ttm->frames.stack = newstack;
+	ttm->frames.alloc = newalloc;
+    }
+    frame = ttm->frames.stack[ttm->frames.top];
+    if(frame == NULL) {
+	frame = (Frame*)calloc(1,sizeof(Frame));
+	if(frame == NULL) FAIL(ttm,TTM_EMEMORY);
+	ttm->frames.stack[ttm->frames.top] = frame;
+	growArgv(ttm,frame,FRAMEARGS0);
+    }
     frame->argc = 0;
+    frame->argv[0] = NULL;
     frame->active = 0;
-    frame->result = vsnew();
+    /* The buffers are kept across calls; see clearFrame */
+    if(frame->args == NULL) frame->args = vsnew();
+    if(frame->result == NULL) frame->result = vsnew();
     return frame;
 }
 
@@ -365,39 +668,119 @@ popFrame(TTM* ttm)
     Frame* frame;
     int top = ttm->frames.top--;
     if(top < 0) FAIL(ttm,TTM_ESTACKUNDERFLOW); /* Actually an internal error */
-    frame = &ttm->frames.stack[top];
+    frame = ttm->frames.stack[top];
     clearFrame(ttm,frame);
 }
 
+/**
+Reset a frame for reuse. The frame buffers keep their
+capacity so that a later call at the same depth does
+not need to allocate, but any capacity beyond FRAMEBUFKEEP
+(left over from an unusually large call) is released.
+*/
 static void
 clearFrame(TTM* ttm, Frame* frame)
 {
     if(frame == NULL) return;
-    clearArgv(frame->argv,frame->argc);
-    vsfree(frame->result);
+    clearLocals(ttm,frame);
+    clearArgv(frame);
+    vsclear(frame->result);
+    vstrim(frame->args,FRAMEBUFKEEP);
+    vstrim(frame->result,FRAMEBUFKEEP);
 }
 
+/* Also reclaims all frames */
 static void
 clearFramestack(TTM* ttm)
 {
-    int i;
-    int top = ttm->frames.top;
-    for(i=0;i<=top;i++) {
-	Frame* f = &ttm->frames.stack[i];
-	clearFrame(ttm,f);
+    size_t i;
+    for(i=0;i<ttm->frames.alloc;i++) {
+	Frame* f = ttm->frames.stack[i];
+	if(f == NULL) continue;
+	clearLocals(ttm,f);
+	vsfree(f->args);
+	vsfree(f->result);
+	nullfree(f->argv);
+	nullfree(f->arglen);
+	free(f);
     }
+    nullfree(ttm->frames.stack);
+    ttm->frames.stack = NULL;
+    ttm->frames.alloc = 0;
+    ttm->frames.top = -1;
 }
 
+/* The argument arena is kept for reuse by the next frame */
 static void
-clearArgv(char** argv, size_t argc)
+clearArgv(Frame* frame)
 {
-    size_t i;
-    for(i=0;i<argc;i++) {
-	char* arg = argv[i];
-	if(arg == NULL) break; /* trailing null */
-	free(arg);
-	argv[i] = NULL;
+    frame->argc = 0;
+    frame->argv[0] = NULL;
+    vsclear(frame->args);
+}
+
+/**
+Make sure that argv and arglen can hold at least need entries.
+@param ttm
+@param frame
+@param need required no. of entries (including the final NULL)
+@return void
+*/
+static void
+growArgv(TTM* ttm, Frame* frame, size_t need)
+{
+    size_t newalloc;
+    char** newargv;
+    size_t* newarglen;
+
+    if(need <= frame->argalloc) return;
+    newalloc = (frame->argalloc == 0 ? FRAMEARGS0 : frame->argalloc);
+    while(newalloc < need) newalloc *= 2;
+    newargv = (char**)calloc(newalloc,sizeof(char*));
+    newarglen = (size_t*)calloc(newalloc,sizeof(size_t));
+    if(newargv == NULL || newarglen == NULL) FAIL(ttm,TTM_EMEMORY);
+    if(frame->argalloc > 0) {
+	memcpy(newargv,frame->argv,frame->argalloc*sizeof(char*));
+	memcpy(newarglen,frame->arglen,frame->argalloc*sizeof(size_t));
+    }
+    nullfree(frame->argv);
+    nullfree(frame->arglen);
+    frame->argv = newargv;
+    frame->arglen = newarglen;
+    frame->argalloc = newalloc;
+}
+
+/**
+Append an argument to the frame's argument arena.
+If the arena moves, then argv must be recomputed.
+@param ttm
+@param frame
+@param arg the argument
+@param arglen |arg|
+@return void
+*/
+static void
+pushArgv(TTM* ttm, Frame* frame, const char* arg, size_t arglen)
+{
+    char* base = vscontents(frame->args);
+    size_t argoff = vslength(frame->args);
+
+    growArgv(ttm,frame,frame->argc+2); /* +1 for the final NULL */
+
+    vsappendn(frame->args,arg,arglen);
+    vsappend(frame->args,NUL8); /* arguments are nul terminated */
+    if(vscontents(frame->args) != base) { /* arena moved */
+	size_t i;
+	char* p = vscontents(frame->args);
+	for(i=0;i<frame->argc;i++) {
+	    frame->argv[i] = p;
+	    p += (frame->arglen[i] + 1);
+	}
     }
+    frame->argv[frame->argc] = vscontents(frame->args) + argoff;
+    frame->arglen[frame->argc] = arglen;
+    frame->argc++;
+    frame->argv[frame->argc] = NULL;
 }
 
 /**************************************************/
@@ -405,11 +788,12 @@ clearArgv(char** argv, size_t argc)
 static Function*
 newFunction(TTM* ttm, const char* name)
 {
-    Function* f = (Function*)calloc(1,sizeof(Function));
+    Function* f = (Function*)poolalloc(&ttm->pools.functions);
     if(f == NULL) FAIL(ttm,TTM_EMEMORY);
     f->fcn.nextsegindex = SEGINDEXFIRST;
     assert(f->entry.name == NULL);
-    f->entry.name = strdup(name);
+    f->entry.hash = computehash(name);
+    f->entry.name = intern(ttm,name,f->entry.hash);
     return f;
 }
 
@@ -417,6 +801,8 @@ static void
 resetFunction(TTM* ttm, Function* f)
 {
     if(f->fcn.body != NULL) vsfree(f->fcn.body);
+    invalidatesegments(f);
+    ttm->callcache.generation++;
     memset(&f->fcn,0,sizeof(struct FcnData));
     f->fcn.nextsegindex = SEGINDEXFIRST;
 }
@@ -426,35 +812,41 @@ freeFunction(TTM* ttm, Function* f)
 {
     assert(f != NULL);
     resetFunction(ttm,f);
+    if(f->entry.name != NULL) releaseatom(ttm,f->entry.name,f->entry.hash);
     clearHashEntry(&f->entry);
-    free(f);
+    if(!isbuiltinslot(ttm,f)) poolfree(&ttm->pools.functions,f);
+}
+
+/* Is f one of the Function objects in ttm->builtins.functions? */
+static int
+isbuiltinslot(TTM* ttm, Function* f)
+{
+    return (ttm->builtins.functions != NULL
+	    && f >= ttm->builtins.functions
+	    && f < ttm->builtins.functions + ttm->builtins.count);
 }
 
 static void
 clearDictionary(TTM* ttm, struct HashTable* dict)
 {
-    size_t i;
-    for(i=0;i<HASHSIZE;i++) {
-	struct HashEntry* cur = dict->table[i].next; /* First entry is a placeholder */
-	while(cur != NULL) {
-	    struct HashEntry* next = cur->next;
-	    struct Function* fcn = (struct Function*)cur;
-	    freeFunction(ttm,fcn);
-	    cur = next;
-	}
-	dict->table[i].next = NULL;
-    }
-    memset(dict,0,sizeof(struct HashTable));
+    void* walker = hashwalk(dict);
+    struct HashEntry* entry = NULL;
+    while(hashnext(walker,&entry))
+	resetFunction(ttm,(struct Function*)entry);
+    hashwalkstop(walker);
+    hashClear(dict);
+    poolclear(&ttm->pools.functions); /* reclaim the functions themselves */
 }
 
 /**************************************************/
 static Charclass*
 newCharclass(TTM* ttm, const char* name)
 {
-    Charclass* cl = (Charclass*)calloc(1,sizeof(Charclass));
+    Charclass* cl = (Charclass*)poolalloc(&ttm->pools.charclasses);
     if(cl == NULL) FAIL(ttm,TTM_EMEMORY);
     assert(cl->entry.name == NULL);
-    cl->entry.name = strdup(name);
+    cl->entry.hash = computehash(name);
+    cl->entry.name = intern(ttm,name,cl->entry.hash);
     return cl;
 }
 
@@ -463,46 +855,133 @@ freeCharclass(TTM* ttm, Charclass* cl)
 {
     assert(cl != NULL);
     nullfree(cl->characters);
+    nullfree(cl->ranges);
+    releaseatom(ttm,cl->entry.name,cl->entry.hash);
     clearHashEntry(&cl->entry);
-    free(cl);
+    poolfree(&ttm->pools.charclasses,cl);
 }
 
 static void
 clearcharclasses(TTM* ttm, struct HashTable* charclasses)
 {
-    size_t i;
-    for(i=0;i<HASHSIZE;i++) {
-	struct HashEntry* cur = charclasses->table[i].next; /* First entry is a placeholder */
-	while(cur != NULL) {
-	    struct HashEntry* next = cur->next;
-	    struct Charclass* cc = (struct Charclass*)cur;
-	    freeCharclass(ttm,cc);
-	    cur = next;
+    void* walker = hashwalk(charclasses);
+    struct HashEntry* entry = NULL;
+    while(hashnext(walker,&entry)) {
+	nullfree(((struct Charclass*)entry)->characters);
+	nullfree(((struct Charclass*)entry)->ranges);
+    }
+    hashwalkstop(walker);
+    hashClear(charclasses);
+    poolclear(&ttm->pools.charclasses); /* reclaim the classes themselves */
+}
+
+/* Order codepoints for compilecharclass() */
+static int
+cpcmp(const void* a, const void* b)
+{
+    unsigned ca = *(const unsigned*)a;
+    unsigned cb = *(const unsigned*)b;
+    return (ca < cb ? -1 : (ca > cb ? 1 : 0));
+}
+
+/**
+Compile cl->characters and cl->negative into the bitmap
+of the matching ASCII characters and the sorted ranges
+of the non-ASCII members, so that charclassmatch() does not
+need to search cl->characters for every character it tests.
+NUL never matches, nor does SEGMARK0, which starts a
+segment mark rather than being a character.
+@param ttm
+@param cl
+@return void
+*/
+static void
+compilecharclass(TTM* ttm, Charclass* cl)
+{
+    const char* p;
+    unsigned* cps = NULL;
+    size_t i, ncps = 0;
+    int ncp;
+
+    memset(cl->ascii,0,sizeof(cl->ascii));
+    nullfree(cl->ranges);
+    cl->ranges = NULL;
+    cl->nranges = 0;
+    for(p=cl->characters;*p;p+=ncp) {
+	ncp = u8size(p);
+	if(ncp <= 0) {ncp = 1; continue;} /* not a codepoint; cannot match anyway */
+	if(ncp == 1) cl->ascii[UTF8(*p) & 0xF] |= (utf8)(1 << (UTF8(*p) >> 4));
+	else if(!issegmark(p)) ncps++;
+    }
+    if(cl->negative)
+	for(i=0;i<sizeof(cl->ascii);i++) cl->ascii[i] = (utf8)~cl->ascii[i];
+    cl->ascii[NUL8 & 0xF] &= (utf8)~(1 << (NUL8 >> 4));
+    cl->ascii[SEGMARK0 & 0xF] &= (utf8)~(1 << (SEGMARK0 >> 4));
+    if(ncps == 0) return;
+
+    /* Sort the non-ASCII members and merge them into ranges */
+    cps = (unsigned*)malloc(ncps*sizeof(unsigned));
+    cl->ranges = (struct CharRange*)malloc(ncps*sizeof(struct CharRange));
+    if(cps == NULL || cl->ranges == NULL) FAIL(ttm,TTM_EMEMORY);
+    for(ncps=0,p=cl->characters;*p;p+=ncp) {
+	ncp = u8size(p);
+	if(ncp <= 0) {ncp = 1; continue;}
+	if(ncp > 1 && !issegmark(p)) cps[ncps++] = u8decode(p);
+    }
+    qsort(cps,ncps,sizeof(unsigned),cpcmp);
+    for(i=0;i<ncps;i++) {
+	struct CharRange* last = (cl->nranges == 0 ? NULL : &cl->ranges[cl->nranges-1]);
+	if(last != NULL && cps[i] <= last->hi + 1) {
+	    if(cps[i] > last->hi) last->hi = cps[i];
+	} else {
+	    cl->ranges[cl->nranges].lo = cps[i];
+	    cl->ranges[cl->nranges].hi = cps[i];
+	    cl->nranges++;
 	}
-	charclasses->table[i].next = NULL;
     }
-    memset(charclasses,0,sizeof(struct HashTable));
+    free(cps);
+}
+
+/* Is the non-ASCII codepoint c in the ranges of cl? */
+static int
+charclassrange(const Charclass* cl, unsigned c)
+{
+    size_t lo = 0, hi = cl->nranges;
+    while(lo < hi) {
+	size_t mid = (lo + hi) / 2;
+	if(c < cl->ranges[mid].lo) hi = mid;
+	else if(c > cl->ranges[mid].hi) lo = mid + 1;
+	else return 1;
+    }
+    return 0;
 }
 
-/* Return ptr to first char not matching charclass
-   taking negative into account.
+/**
+Return ptr to first char not matching charclass
+taking negative into account.
+@param cl the compiled class
+@param cp start of the text to match
+@param len of the text in bytes
+@return ptr to the first non-matching char or to cp+len
 */
 static const char*
-charclassmatch(const char* cp, const char* charclass, int negative)
-{
-    const char* p = NULL;
-    const char* q = NULL;
-    for(p=cp;*p;p+=u8size(p)) {
-	q = strchr8(charclass,p);
-	/* 4 cases: */
- 	     if(q == NULL && !negative)	/* p not in class && !negative => !match */
-		{break;}
-	else if(q != NULL && !negative)	/* p in class     && !negative =>  match */
-		{}
-	else if(q == NULL &&  negative)	/* p not in class &&  negative =>  match */
-		{}
-	else if(q != NULL &&  negative)	/* p in class     &&  negative => !match */
-		{break;}
+charclassmatch(const Charclass* cl, const char* cp, size_t len)
+{
+    const char* p = cp;
+    const char* end = cp + len;
+
+    while(p < end) {
+	int ncp;
+	/* Skip the run of matching ASCII characters */
+	p += classspan(cl,p,(size_t)(end - p));
+	if(p >= end) break;
+	/* p is a non-matching ASCII character, or one the bitmap cannot decide */
+	if(UTF8(*p) < 0x80 && !issegmark(p)) break;
+	ncp = u8size(p);
+	if(ncp <= 0 || ncp > (end - p)) break;
+	/* A segment mark is never in a class, so it matches only a negative one */
+	if((issegmark(p) ? 0 : charclassrange(cl,u8decode(p))) == cl->negative) break;
+	p += ncp;
     }
     return p;
 }
@@ -515,6 +994,8 @@ propenumdetect(const char* s)
     if(strcmp("execcount",(const char*)s)==0) return PE_EXECCOUNT;
     if(strcmp("showfinal",(const char*)s)==0) return PE_SHOWFINAL;
     if(strcmp("showcall",(const char*)s)==0)  return PE_SHOWCALL;
+    if(strcmp("gclimit",(const char*)s)==0)  return PE_GCLIMIT;
+    if(strcmp("compactinterval",(const char*)s)==0)  return PE_COMPACTINTERVAL;
     return PE_UNDEF;
 }
 
@@ -546,6 +1027,9 @@ ttmenumdetect(const char* s)
     if(strcmp("list",s)==0) return TE_LIST;
     if(strcmp("all",s)==0) return TE_ALL;
     if(strcmp("builtin",s)==0) return TE_BUILTIN;
+    if(strcmp("stats",s)==0) return TE_STATS;
+    if(strcmp("gc",s)==0) return TE_GC;
+    if(strcmp("compact",s)==0) return TE_COMPACT;
     return TE_UNDEF;
 }
 
@@ -553,16 +1037,35 @@ ttmenumdetect(const char* s)
 
 /**
 This is basic top level scanner.
+It is also the driver for nested calls: rather than recursing
+on the C stack, a call whose arguments contain another call
+is suspended in its frame (see Frame.argoff) while the inner
+call is collected and executed. So the frames above the
+entry depth act as the continuation stack and the call
+nesting depth is limited only by the stacksize property.
+Since scan() may be re-entered (e.g. by #<catch>), it only
+acts on the frames that it pushed itself.
 */
 static TTMERR
 scan(TTM* ttm)
 {
     TTMERR err = TTM_NOERR;
+    int base = ttm->frames.top; /* frames at or below this belong to a caller */
     char* cp8;
     int ncp;
 
     TTMCP8SET(ttm); 
     for(;;) {
+	if(ttm->frames.top > base) { /* collecting the args of a call */
+	    Frame* frame = ttm->frames.stack[ttm->frames.top];
+	    int complete = 0;
+	    err = collectargs(ttm,frame,&complete);
+	    if(err == TTM_NOERR && complete)
+		err = exec(ttm,frame);
+	    if(err != TTM_NOERR) goto fail;
+	    if(ttm->flags.exit) goto fail;
+	    continue;
+	}
 	TTMCP8SET(ttm); /* note that we do not bump here */
 	if(isnul(cp8)) { /* End of buffer */
 	    break;
@@ -574,14 +1077,10 @@ scan(TTM* ttm)
 	    vsindexappendn(ttm->vs.passive,cp8,ncp); /* pass the escaped char */
 	    TTMCP8NXT(ttm); /* skip escaped char */
 	} else if(u8equal(cp8,ttm->meta.sharpc)) {/* Start of call? */
-	    if(u8equal(peek(ttm->vs.active,1),ttm->meta.openc)
-		|| (u8equal(peek(ttm->vs.active,1),ttm->meta.sharpc)
-		    && (u8equal(peek(ttm->vs.active,2),ttm->meta.openc)))) {
+	    if(iscall(ttm,cp8)) {
 		/* It is a real call */
-		TTMCP8SET(ttm);
-		err = exec(ttm);
-		if(err != TTM_NOERR) EXIT(err);
-		if(ttm->flags.exit) goto done;
+		err = startcall(ttm);
+		if(err != TTM_NOERR) goto fail;
 	    } else {/* not an call; just pass the # along passively */
 		vsindexappendn(ttm->vs.passive,cp8,ncp);
 		TTMCP8NXT(ttm);
@@ -606,14 +1105,12 @@ scan(TTM* ttm)
 			vsindexappendn(ttm->vs.passive,cp8,ncp); /* Keep rbrc */
 		    }
 		    TTMCP8NXT(ttm); /* Skip rbrc */
-		} else { /*ordinary char */
-		    vsindexappendn(ttm->vs.passive,cp8,ncp); /* Keep lbrc */
-		    TTMCP8NXT(ttm); /* Skip lbrc */
+		} else { /*ordinary char(s) */
+		    TTMCP8RUN(ttm,SIG_BRC);
 		}
 	    } /*<...> while*/
-	} else { /* non-signficant character */
-	    vsindexappendn(ttm->vs.passive,(char*)cp8,ncp);
-	    TTMCP8NXT(ttm);
+	} else { /* non-signficant character(s) */
+	    TTMCP8RUN(ttm,SIG_SCAN);
 	}
     } /*scan for*/
 
@@ -624,23 +1121,42 @@ scan(TTM* ttm)
 
 done:
     return THROW(err);
+
+fail:
+    /* Abandon any calls in progress. If the error is fatal,
+       then leave them in place for the error report. */
+    if(err == TTM_NOERR || ttm->flags.catchdepth > 0) {
+	while(ttm->frames.top > base) popFrame(ttm);
+    }
+    goto done;
 }
 
 /**
-Compute a function and leave the result into:
-1. ttm->vs.active if the function is active or
-2. ttm->vs.passive
+Check if the sharp at cp8 starts a call: #< or ##<
+@param ttm
+@param cp8 pointer to a sharp character
+@return 1 if a call, 0 otherwise
+*/
+static int
+iscall(TTM* ttm, const char* cp8)
+{
+    const char* peek1 = peek(cp8,1);
+    return (u8equal(peek1,ttm->meta.openc)
+	    || (u8equal(peek1,ttm->meta.sharpc)
+		&& u8equal(peek(cp8,2),ttm->meta.openc)));
+}
+
+/**
+Begin a call: push a new frame and skip the #< or ##<.
+The arguments are then collected by collectargs().
 @param ttm
 @return TTMERR
 */
 static TTMERR
-exec(TTM* ttm)
+startcall(TTM* ttm)
 {
     TTMERR err = TTM_NOERR;
     Frame* frame = NULL;
-    Function* fcn = NULL;
-    size_t savepassive;
-    TRACE tracebefore = TR_UNDEF;
     char* cp8 = NULL;
     int ncp;
 
@@ -653,7 +1169,7 @@ exec(TTM* ttm)
     TTMCP8SET(ttm);    
     
     /* Skip to the start of the function name */
-    if(u8equal(peek(ttm->vs.active,1),ttm->meta.openc)) {
+    if(u8equal(peek(cp8,1),ttm->meta.openc)) {
 	TTMCP8NXT(ttm); /* skip '#' */
 	TTMCP8NXT(ttm); /* skip '<' */
 	frame->active = 1;
@@ -664,11 +1180,36 @@ exec(TTM* ttm)
 	frame->active = 0;
     }
 
-    /* Parse and store relevant pointers into frame. */
-    savepassive = vslength(ttm->vs.passive);
-    collectargs(ttm,frame);
-    vssetlength(ttm->vs.passive,savepassive);
-    if(ttm->flags.exit) goto done;
+    /* The args are collected at the end of the passive buffer */
+    frame->savepassive = vslength(ttm->vs.passive);
+    frame->argoff = vsindex(ttm->vs.passive);
+    if(ttm->debug.debug > 0) dumpstack(ttm);
+done:
+    return THROW(err);
+}
+
+/**
+Compute a function and leave the result into:
+1. ttm->vs.active if the function is active or
+2. ttm->vs.passive
+The frame must be the top frame and must have
+all its arguments collected; it is popped on return.
+@param ttm
+@param frame
+@return TTMERR
+*/
+static TTMERR
+exec(TTM* ttm, Frame* frame)
+{
+    TTMERR err = TTM_NOERR;
+    Function* fcn = NULL;
+    TRACE tracebefore = TR_UNDEF;
+    char* cp8 = NULL;
+    int ncp;
+
+    UNUSED(ncp);
+
+    vssetlength(ttm->vs.passive,frame->savepassive);
 
     if(ttm->debug.debug > 1) {
 	xprintf(ttm,"exec: ");
@@ -677,9 +1218,14 @@ exec(TTM* ttm)
 
     /* Now execute this function, which will leave result in bb->result */
     if(frame->argc == 0) EXIT(TTM_EBADCALL);
-    if(strlen((char*)frame->argv[0])==0) EXIT(TTM_EBADCALL);
+    if(frame->arglen[0]==0) EXIT(TTM_EBADCALL);
+    /* This is a safe point to collect or compact: no Function* is held */
+    if(ttm->properties.gclimit > 0 && ttm->pools.functions.inuse >= ttm->gc.threshold)
+	(void)gcnames(ttm);
+    if(ttm->properties.compactinterval > 0 && --ttm->compact.countdown == 0)
+	(void)compact(ttm);
     /* Locate the function to execute */
-    fcn = dictionaryLookup(ttm,frame->argv[0]);
+    fcn = callcacheLookup(ttm,frame->argv[0],frame->namehash);
     if(fcn == NULL) EXIT(TTM_ENONAME);
     if(fcn->fcn.minargs > (frame->argc - 1)) /* -1 to account for function name*/
 	EXIT(TTM_EFEWPARMS);
@@ -699,7 +1245,7 @@ exec(TTM* ttm)
 	err = fcn->fcn.fcn(ttm,frame,ttm->vs.result);
 	if(fcn->fcn.novalue) vsclear(ttm->vs.result);
     } else /* invoke the pseudo function "call" */
-	call(ttm,frame,vscontents(fcn->fcn.body),ttm->vs.result);
+	call(ttm,frame,fcn,ttm->vs.result);
 
     /* Trace exit result iff traced entry */
     if(tracebefore == TR_ON) {
@@ -723,21 +1269,21 @@ exec(TTM* ttm)
 
     if(ttm->flags.exit) goto done;
 
-    /* Remove the scanned characters in ttm->vs.active (index => 0) */
-    {
-	size_t elide = (size_t)(vsindexp(ttm->vs.active) - vscontents(ttm->vs.active));
-	vsremoven(ttm->vs.active,0,elide);
-	assert(vsindex(ttm->vs.active)==0);
-    }
-    
     /* Now, put the result into the buffer */
     if(!fcn->fcn.novalue && vslength(ttm->vs.result) > 0) {
 	/* We insert the result as follows:
 	   frame->passive => insert in ttm->vs.passive
-	   frame->active => insert at ttm->vs.active index
+	   frame->active => insert just before ttm->vs.active index;
+	   the already scanned characters in front of the index
+	   are reused as a gap, so the unscanned remainder of
+	   ttm->vs.active is (usually) not moved.
+	   As a special case, an active result that has nothing
+	   for scan() or collectargs() to act on would just be copied
+	   to ttm->vs.passive, so it is treated as passive.
 	*/
-	if(frame->active) {
-	    (void)vsinsertn(ttm->vs.active, 0, vscontents(ttm->vs.result), vslength(ttm->vs.result));
+	if(frame->active
+	   && !metafree(ttm,vscontents(ttm->vs.result),vslength(ttm->vs.result))) {
+	    vsindexprependn(ttm->vs.active,vscontents(ttm->vs.result),vslength(ttm->vs.result));
 	} else { /*frame->passive*/
 	    vsindexappendn(ttm->vs.passive,vscontents(ttm->vs.result),vslength(ttm->vs.result));
 	}
@@ -750,37 +1296,25 @@ done:
 }
 
 /**
-Construct a frame; leave ttm->vs.active pointing just past the closing '>'
+Continue collecting the arguments of a frame; leave ttm->vs.active
+pointing just past the closing '>' or at the start of a nested call.
+In the latter case, the nested call's frame has been pushed
+and this frame is resumed after the nested call completes.
 @param ttm
 @param frame
+@param completep set to 1 if all the arguments have been collected
 @return TTMERR
 */
 static TTMERR
-collectargs(TTM* ttm, Frame* frame)
+collectargs(TTM* ttm, Frame* frame, int* completep)
 {
     TTMERR err = TTM_NOERR;
-    int done,depth;
+    int depth;
     char* argp = NULL;
-    size_t argoff = 0;
     char* cp8 = NULL;
     int ncp;
 
-#if 0
-{
-const char* p;
-TTMCP8SET(ttm);
-for(p=cp8;*p;p++) {
-if(strchr("	 \r\n",*p) != NULL)
-p++;
-}
-fprintf(stderr,"@@@ |%50s|\n",p);
-dumpstack(ttm);
-}
-#endif
-dumpstack(ttm);
-    argoff = vsindex(ttm->vs.passive);
-    done = 0; depth = 0;
-    while(!done) { /* Loop until all args are collected */
+    for(;;) { /* Loop until all args are collected */
 	TTMCP8SET(ttm);
 	if(isnul(cp8)) EXIT(TTM_EEOS); /* Unexpected end of buffer */
 	if(isescape(cp8)) {
@@ -789,29 +1323,27 @@ dumpstack(ttm);
 	    TTMCP8NXT(ttm);
 	} else if(u8equal(cp8,ttm->meta.semic) || u8equal(cp8,ttm->meta.closec)) {
 	    /* End of an argument */
-	    /* move to next arg */
-	    if(u8equal(cp8,ttm->meta.closec)) done=1;
+	    int done = u8equal(cp8,ttm->meta.closec);
 	    if(frame->argc >= MAXARGS) EXIT(TTM_EMANYPARMS)
-	    vsindexset(ttm->vs.passive,argoff);
+	    vsindexset(ttm->vs.passive,frame->argoff);
 	    argp = vsindexp(ttm->vs.passive);
-	    frame->argv[frame->argc++] = strdup(argp);
-	    vssetlength(ttm->vs.passive,argoff);
+	    if(frame->argc == 0) /* the function name; hash it once for exec() */
+		frame->namehash = computehashn(argp,vslength(ttm->vs.passive) - frame->argoff);
+	    pushArgv(ttm,frame,argp,vslength(ttm->vs.passive) - frame->argoff);
+	    vssetlength(ttm->vs.passive,frame->argoff);
 	    TTMCP8NXT(ttm); /* skip the semi or close */
-	    if(!done)
-		argoff = vsindex(ttm->vs.passive);
+	    if(done) {*completep = 1; break;}
+	    /* move to next arg */
+	    frame->argoff = vsindex(ttm->vs.passive);
 	} else if(u8equal(cp8,ttm->meta.sharpc)) {
 	    /* check for call within call */
-	    const char* peek1 = peek(ttm->vs.active,1);
-	    const char* peek2 = peek(ttm->vs.active,2);
-	    if(u8equal(peek1,ttm->meta.openc)
-	       || (u8equal(peek1,ttm->meta.sharpc)
-		   && u8equal(peek2,ttm->meta.openc))) {
-		/* Recurse to compute inner call */
-		TTMCP8SET(ttm);
-		err = exec(ttm);
-		if(err != TTM_NOERR) EXIT(err);
-		TTMCP8SET(ttm);
-		if(ttm->flags.exit) goto done;
+	    if(iscall(ttm,cp8)) {
+		/* Suspend this frame to compute inner call */
+		err = startcall(ttm);
+		break;
+	    } else { /* not a call; keep the sharp */
+		vsindexappendn(ttm->vs.passive,cp8,ncp);
+		TTMCP8NXT(ttm);
 	    }
 	} else if(u8equal(cp8,ttm->meta.lbrc)) {/* <...> nested brackets */
 	    depth = 1;
@@ -833,14 +1365,12 @@ dumpstack(ttm);
 		    TTMCP8NXT(ttm);
 		    if(depth == 0) break; /* we are done */
 		} else {
-		    vsindexappendn(ttm->vs.passive,cp8,ncp);
-		    TTMCP8NXT(ttm);
+		    TTMCP8RUN(ttm,SIG_BRC);
 		}
 	    }/*<...> for*/
 	} else {
 	    /* keep moving */
-	    vsindexappendn(ttm->vs.passive,cp8,ncp);
-	    TTMCP8NXT(ttm);
+	    TTMCP8RUN(ttm,SIG_ARG);
 	}
     } /* collect argument for */
 done:
@@ -851,36 +1381,178 @@ done:
 Execute a non-builtin function
 @param ttm
 @param frame args for function call
-@param body for user-defined functions.
+@param fcn the user-defined function
+@param result
 */
 static TTMERR
-call(TTM* ttm, Frame* frame, char* body, VString* result)
+call(TTM* ttm, Frame* frame, Function* fcn, VString* result)
 {
     TTMERR err = TTM_NOERR;
-    char crval[CREATELEN+1];
-    char* b8;
+    char crval[MAXCREATEDIGITS+1]; /* CREATELEN is only the minimum width */
+    const char* body;
+    const Segment* seg;
+    const Segment* segend;
+
+    if(fcn->fcn.segments == NULL) buildsegments(ttm,fcn);
+    body = vscontents(fcn->fcn.body);
+    seg = (const Segment*)vacontents(fcn->fcn.segments);
+    segend = seg + valength(fcn->fcn.segments);
 
     /* Compute the body using result  */
     crval[0] = '\0'; /* also use as a flag to indicate create value was created */
-    for(b8=body;!isnul(b8);b8+=u8size(b8)) {
-	if(issegmark(b8)) {
-	    size_t segindex = segmarkindex(b8);
-	    if(iscreateindex(segindex)) {
-		if(crval[0] == '\0') { /* create the create value once only */
-		    ttm->flags.crcounter++;
-		    snprintf(crval,sizeof(crval),CREATEFORMAT,ttm->flags.crcounter);
-		}
-		vsappendn(result,crval,CREATELEN);
-	    } else if(segindex < frame->argc) {
-		char* arg = frame->argv[segindex];
-		vsappendn(result,arg,strlen(arg));
-	    } /* else treat as null string */
-	} else
-	    vsappendn(result,b8,u8size(b8));
+    for(;seg < segend;seg++) {
+	size_t segindex = seg->segindex;
+	if(segindex == SEGTEXT) {
+	    vsappendn(result,body+seg->offset,seg->length);
+	} else if(iscreateindex(segindex)) {
+	    if(crval[0] == '\0') { /* create the create value once only */
+		ttm->flags.crcounter++;
+		snprintf(crval,sizeof(crval),CREATEFORMAT,ttm->flags.crcounter);
+	    }
+	    vsappendn(result,crval,strlen(crval));
+	} else if(segindex < frame->argc) {
+	    if(frame->arglen[segindex] > 0)
+		vsappendn(result,frame->argv[segindex],frame->arglen[segindex]);
+	} /* else treat as null string */
     }
     return THROW(err);
 }
 
+/**
+Pre-parse a function body into a list of Segments
+so that call() can copy the text between marks in bulk.
+Since SEGMARK0 is ASCII, the marks can be found bytewise.
+@param ttm
+@param f the function
+@return void
+*/
+static void
+buildsegments(TTM* ttm, Function* f)
+{
+    const char* body = vscontents(f->fcn.body);
+    const char* p = body;
+    const char* end = body + vslength(f->fcn.body);
+    Segment seg;
+
+    if(f->fcn.segments != NULL) vafree(f->fcn.segments); /* but keep the codepoint index */
+    f->fcn.segments = vanew(sizeof(Segment));
+    while(p != NULL && p < end) {
+	const char* q = (const char*)memchr(p,SEGMARK0,(size_t)(end - p));
+	if(q == NULL) q = end;
+	if(q > p) { /* text run; vsappendn treats a zero length specially */
+	    seg.segindex = SEGTEXT;
+	    seg.offset = (size_t)(p - body);
+	    seg.length = (size_t)(q - p);
+	    vaappend(f->fcn.segments,&seg);
+	}
+	if(q == end) break;
+	seg.segindex = segmarkindex(q);
+	seg.offset = 0;
+	seg.length = 0;
+	vaappend(f->fcn.segments,&seg);
+	p = q + SEGMARKSIZE;
+    }
+}
+
+/**
+Discard the Segment list and codepoint index of a function;
+must be called whenever the content of its body changes.
+@param f the function
+@return void
+*/
+static void
+invalidatesegments(Function* f)
+{
+    if(f->fcn.segments != NULL) vafree(f->fcn.segments);
+    f->fcn.segments = NULL;
+    if(f->fcn.cpindex != NULL) vafree(f->fcn.cpindex);
+    f->fcn.cpindex = NULL;
+    f->fcn.cpascii = 0;
+}
+
+/**
+Build the codepoint index of a function body: the byte offset
+of codepoint k*CPINDEXSTEP for k = 0,1,... An all ASCII body
+needs no checkpoints and is just marked as such (cpascii).
+As with strsubcp(), a segment|create mark counts as one codepoint.
+@param ttm
+@param f the function
+@return 1 if built; 0 if the body is malformed, in which case
+the caller must walk the body itself
+*/
+static int
+buildcpindex(TTM* ttm, Function* f)
+{
+    const char* body = vscontents(f->fcn.body);
+    size_t len = vslength(f->fcn.body);
+    size_t off;
+
+    if(u8validspan(body,len) < len) return 0;
+    if(f->fcn.cpindex != NULL) vafree(f->fcn.cpindex); /* but keep the Segment list */
+    f->fcn.cpascii = 0;
+    f->fcn.cpindex = vanew(sizeof(size_t));
+    if(asciispan(body,len) == len) {f->fcn.cpascii = 1; return 1;}
+    for(off=0;off < len;off += u8skip(body+off,len-off,CPINDEXSTEP))
+	vaappend(f->fcn.cpindex,&off);
+    return 1;
+}
+
+/**
+Convert a byte offset in a function body, typically its residual
+pointer, to a codepoint offset, using the codepoint index.
+@param ttm
+@param f the function
+@param rp byte offset (<= length of body)
+@param cpp return the codepoint offset
+@return TTMERR; see strsubcp
+*/
+static TTMERR
+bodyrptocp(TTM* ttm, Function* f, size_t rp, size_t* cpp)
+{
+    const char* body = vscontents(f->fcn.body);
+    const size_t* checks;
+    size_t lo, hi;
+
+    if(f->fcn.cpindex == NULL && !buildcpindex(ttm,f))
+	return strsubcp(body,rp,cpp);
+    if(f->fcn.cpascii) {*cpp = rp; return TTM_NOERR;}
+    /* Find the last checkpoint at or before rp and walk from there;
+       checks[0] == 0 since the body is not empty */
+    checks = (const size_t*)vacontents(f->fcn.cpindex);
+    for(lo=0,hi=valength(f->fcn.cpindex);hi - lo > 1;) {
+	size_t mid = (lo + hi) / 2;
+	if(checks[mid] <= rp) lo = mid; else hi = mid;
+    }
+    *cpp = lo * CPINDEXSTEP + u8count(body+checks[lo],rp-checks[lo]);
+    return TTM_NOERR;
+}
+
+/**
+Convert a codepoint offset in a function body to a byte offset,
+using the codepoint index; an offset past the end of the body
+is converted to the length of the body.
+@param ttm
+@param f the function
+@param cp codepoint offset
+@return byte offset
+*/
+static size_t
+bodycptorp(TTM* ttm, Function* f, size_t cp)
+{
+    const char* body = vscontents(f->fcn.body);
+    size_t len = vslength(f->fcn.body);
+    size_t k, rp;
+
+    if(f->fcn.cpindex == NULL && !buildcpindex(ttm,f))
+	return cptorp(ttm,body,cp);
+    if(f->fcn.cpascii) return (cp < len ? cp : len);
+    k = cp / CPINDEXSTEP;
+    if(k >= valength(f->fcn.cpindex)) /* walk from the last checkpoint */
+	k = valength(f->fcn.cpindex) - 1;
+    rp = ((const size_t*)vacontents(f->fcn.cpindex))[k];
+    return rp + u8skip(body+rp,len-rp,cp - k*CPINDEXSTEP);
+}
+
 /**************************************************/
 /* Built-in Support Procedures */
 
@@ -1141,15 +1813,13 @@ ttmreset(TTM* ttm)
 static void
 lockup(TTM* ttm)
 {
-    int i;
-    for(i=0;i<HASHSIZE;i++) {
-	struct HashEntry* entry = ttm->tables.dictionary.table[i].next;
-	while(entry != NULL) {
-	    Function* str = (Function*)entry;
-	    str->fcn.locked = 1;
-	    entry = entry->next;
-	}
+    void* walker = hashwalk(&ttm->tables.dictionary);
+    struct HashEntry* entry = NULL;
+    while(hashnext(walker,&entry)) {
+	Function* str = (Function*)entry;
+	str->fcn.locked = 1;
     }
+    hashwalkstop(walker);
 }
 
 /**************************************************/
@@ -1326,56 +1996,43 @@ sv(Function* f)
 }
 
 /**
-Peek at the nth char past the index.
+Peek at the nth char past cp8.
 Return a pointer to that char.
-Leave index unchanged.
 If EOS is encountered, then no advancement occurs
-@param vs
+@param cp8 current codepoint
 @param n number of codepoint to peek ahead
 @return cpa ptr to n'th codepoint
 */
 static const char*
-peek(VString* vs, size_t n)
+peek(const char* cp8, size_t n)
 {
-    size_t saveindex = vsindex(vs);
-    size_t i;
-    char* p = NULL;
+    const char* p = cp8;
 
-    p = vsindexp(vs);
-    for(i=0;i<n;i++) {
+    for(;n > 0;n--) {
+	int ncp = U8SIZE(p);
+	int i;
 	if(isnul(p)) break;
-	vsindexskip(vs,(size_t)u8size(p));
-	p = vsindexp(vs);
+	if(ncp <= 0) ncp = 1; /* step over an invalid byte */
+	/* do not step over a nul in a truncated codepoint */
+	for(i=0;i<ncp && !isnul(p);i++) p++;
     }
-    vsindexset(vs,saveindex);
     return p;
 }
 
 /**
-Convert a residual count to a codepoint count.
+Check if a string can be passed through unchanged by scan() and collectargs().
+This is true if it contains no meta characters and no characters
+that scan() would ignore.
 @param ttm
-@param u8 utf8 string
-@param rp residual count associated with u8 in units of utf8
-@return residual count in units of codepoints
+@param s8 string to check
+@param len |s8| in bytes
+@return 1 if no rescan needed, 0 otherwise
 */
-static size_t
-rptocp(TTM* ttm, const char* u8, size_t rp)
+static int
+metafree(TTM* ttm, const char* s8, size_t len)
 {
-    const char* p;
-    size_t count = 0;
-    int ncp;
-
-    if(u8 != NULL) {
-	const char* u8end = u8 + rp;
-	for(p=u8;*p;) {
-	    ncp = u8size(p);
-	    assert(ncp > 0);
-	    if(p < u8end) {p += ncp; count++; continue;}
-	    if(p == u8end) {break;}
-	    if(p > u8end) {break;} /* technically indicates a malformed utf8 codepoint */
-	}
-    }
-    return count;
+    /* Conservative: any byte that might start a meta char forces a rescan */
+    return (sigspan(ttm,s8,len,SIG_ALL) == len);
 }
 
 /**
@@ -1478,7 +2135,8 @@ usage(const char* msg)
 }
 
 /**
-Read one full line of iput from specified file.
+Process one full line of input held in memory; the input is
+broken into lines as it was when it was read a codepoint at a time.
 Note for each line read if it ends in an escapechar+newline
 then another line is read and appended to current line.
 This repeats until a line is read that does not end in escapechar+newline.
@@ -1486,46 +2144,61 @@ Note that encountering a bare EOF/EOS also terminates the line.
 Note that comments are allowed using "//" style comments although
      this may leave cruft. Escaping of '/' is allowed to pass '/' characters 
 @param ttm
-@param f file from which to read
-@param linep hold line(s) read from stdin
-@return TTM_NOERR if data; TTM_EXXX if error
+@param pp start of the line; set to the start of the next line
+@param end end of the input, which must be valid UTF-8
+@param buf append the processed line to this
+@return TTM_NOERR if data; TTM_EEOF if no complete line is left
 */
 static TTMERR
-readline(TTM* ttm, TTMFILE* f, char** linep)
+readline(TTM* ttm, const char** pp, const char* end, VString* buf)
 {
     TTMERR err = TTM_NOERR;
-    int np8;
-    utf8cpa p8;
-    char* result = NULL;
+    const char* p = *pp;
+    const char* nl;
+    const char* esc;
+    const char* eos;
+    const char* lineend; /* the line is p..lineend-1 */
     char* decom = NULL;
-    VString* line = vsnew();
-    
-    vsclear(line);
-    for(;;) { /* Read thru next \n or \0 (EOF) */
-	if((np8=ttmnonl(ttm,f,p8)) <= 0) {err = THROW(TTM_EUTF8); goto done;}
-	if(isnul(p8)) {err = TTM_EEOF; goto done;}
-	if(*p8 == '\\') { /* Don't use ttm->meta.escapec */
-	    /* peek to see if this escape at end of line: '\''\n' */
-	    if((np8=ttmnonl(ttm,f,p8)) <= 0) {err = THROW(TTM_EUTF8); goto done;}
-	    if(u8equal(p8,"\n")) {
-		/* escape of \n => elide escape and \n and continue reading */
-	    } else { /* pass the escape and the escaped char */
-		vsappendn(line,"\\",1);
-		vsappendn(line,p8,np8);
-	    }
-	    break;
-	} else if(u8equal(p8,"\n")) {
-	    vsappendn(line,p8,np8);
-	    break;
-	} else { /* char other than nul or escape */
-	    vsappendn(line,p8,np8);
+    char* result = NULL;
+    VString* line = NULL;
+
+    /* Read thru next \n or escape or NUL (EOF); all are ASCII,
+       so searching bytewise cannot find them inside a codepoint */
+    nl = (const char*)memchr(p,'\n',(size_t)(end - p));
+    if(nl == NULL) nl = end;
+    esc = (const char*)memchr(p,'\\',(size_t)(nl - p));
+    eos = (const char*)memchr(p,NUL8,(size_t)((esc == NULL ? nl : esc) - p));
+    if(eos != NULL || (esc == NULL && nl == end)) {
+	/* EOF before the end of the line; drop the fragment */
+	*pp = (eos != NULL ? eos : end);
+	EXIT(TTM_EEOF);
+    }
+    if(esc != NULL) { /* Don't use ttm->meta.escapec */
+	if(esc + 1 < end && esc[1] == '\n') {
+	    /* escape of \n => elide escape and \n */
+	    lineend = esc;
+	    *pp = esc + 2;
+	} else if(esc + 1 < end && esc[1] != NUL8) { /* pass the escape and the escaped char */
+	    *pp = lineend = esc + 1 + u8size(esc+1);
+	} else { /* escape of EOF or NUL => elide both */
+	    lineend = esc;
+	    *pp = (esc + 1 < end ? esc + 2 : end);
 	}
+    } else
+	*pp = lineend = nl + 1;
+    if(lineend == p) goto done;
+    /* Only a line with a comment or an escape needs processing */
+    if(esc == NULL && !hascomment(p,(size_t)(lineend - p))) {
+	vsappendn(buf,p,(size_t)(lineend - p));
+	goto done;
     }
+    line = vsnew();
+    vsappendn(line,p,(size_t)(lineend - p));
     /* Check for comments */
     decom = uncomment(vscontents(line));
     /* Convert any escapes to produce final result */
     result = unescape(decom);
-    if(linep) {*linep = result; result = NULL;}
+    if(result != NULL) vsappendn(buf,result,0);
 done:
     nullfree(decom);
     nullfree(result);
@@ -1533,9 +2206,22 @@ done:
     return err;
 }
 
+/* Does text contain "//" (see uncomment)? */
+static int
+hascomment(const char* text, size_t len)
+{
+    const char* p = text;
+    const char* end = text + len;
+    while(p < end && (p = (const char*)memchr(p,SLASH,(size_t)(end - p))) != NULL) {
+	if(p + 1 < end && p[1] == SLASH) return 1;
+	p += 2; /* p[1] is not a slash */
+    }
+    return 0;
+}
 
 /**
-Read a file to EOF
+Read a file to EOF; the whole file is read and validated
+before it is broken into lines.
 @param ttn
 @param file to read
 @param buf hold text of file
@@ -1546,21 +2232,49 @@ readfile(TTM* ttm, const char* fname, VString* buf)
 {
     TTMERR err = TTM_NOERR;
     TTMFILE* f = NULL;
-    char* oneline = NULL;
-    int quit = 0;
+    VString* text = NULL;
+    const char* p;
+    const char* end;
+    char* q;
+    size_t n, len, valid;
+    int malformed = 0;
+
     f = ttmopen(ttm,fname,"rb");
     if(f == NULL) {err = errno; goto done;}
-    while(!quit) {
-	switch (err=readline(ttm,f,&oneline)) {
-	case TTM_NOERR: vsappendn(buf,oneline,0); break;
-	case TTM_EEOF: quit = 1; break; /* no more input */
-	default: goto done;
+    text = vsnew();
+    do {
+	len = vslength(text);
+	vssetalloc(text,len + READCHUNK);
+	n = fread(vscontents(text)+len,1,vsalloc(text) - len,f->file);
+	vssetlength(text,len + n);
+    } while(n > 0);
+    if(ttmerror(ttm,f)) FAIL(ttm,TTM_EIO);
+    ttmclose(ttm,f);
+    p = vscontents(text);
+    len = vslength(text);
+    if(len == 0) {err = TTM_EEOF; goto done;}
+    /* Check the text in bulk rather than a codepoint at a time;
+       a codepoint cut off by EOF is treated as EOF. Malformed text
+       is an error only if it is reached before a NUL (EOF). */
+    end = p + len;
+    if((valid = u8validspan(p,len)) < len) {
+	int ncp = u8size(p+valid);
+	malformed = (ncp <= 0 || (size_t)ncp <= len - valid);
+	end = p + valid;
+    }
+    /* Convert occurrences of \r\n -> \r, as ttmnonl() does */
+    if((q = (char*)memchr(p,'\r',(size_t)(end - p))) != NULL) {
+	const char* r;
+	for(r=q;r < end;) {
+	    if(r[0] == '\r' && r + 1 < end && r[1] == '\n') {*q++ = *r; r += 2;}
+	    else *q++ = *r++;
 	}
-	nullfree(oneline); oneline = NULL;
+	end = q;
     }
-    ttmclose(ttm,f);
+    while((err = readline(ttm,&p,end,buf)) == TTM_NOERR);
+    if(malformed && p == end) FAIL(ttm,TTM_EUTF8);
 done:
-    nullfree(oneline);
+    vsfree(text);
     return err;
 }
 
@@ -1591,6 +2305,16 @@ syncproperty(TTM* ttm, const char* key, const char* value)
    case PE_SHOWCALL:
 	ttm->properties.showcall = (tfcvt(value)?1:0);
 	break;
+    case PE_GCLIMIT:
+	sscanf(value,"%zu",&n);
+	ttm->properties.gclimit = n;
+	ttm->gc.threshold = n;
+	break;
+    case PE_COMPACTINTERVAL:
+	sscanf(value,"%zu",&n);
+	ttm->properties.compactinterval = n;
+	ttm->compact.countdown = n;
+	break;
     default: break; /* user defined property */
     }
 }
@@ -1612,6 +2336,8 @@ propdfalt(enum PropEnum key)
     case PE_EXECCOUNT: return DFALTEXECCOUNT;
     case PE_SHOWFINAL: return DFALTSHOWFINAL;
     case PE_SHOWCALL:  return DFALTSHOWCALL;
+    case PE_GCLIMIT:   return DFALTGCLIMIT;
+    case PE_COMPACTINTERVAL: return DFALTCOMPACTINTERVAL;
     default: break;
     }
     return 0;
@@ -1630,6 +2356,10 @@ defaultproperties(TTM* ttm)
     setproperty(ttm,"showfinal",s);
     s = propdfalt2str(PE_SHOWCALL,DFALTSHOWCALL);
     setproperty(ttm,"showcall",s);
+    s = propdfalt2str(PE_GCLIMIT,DFALTGCLIMIT);
+    setproperty(ttm,"gclimit",s);
+    s = propdfalt2str(PE_COMPACTINTERVAL,DFALTCOMPACTINTERVAL);
+    setproperty(ttm,"compactinterval",s);
 }
 
 /* Insert any command line -P option */
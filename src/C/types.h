@@ -90,7 +90,10 @@ TE_LIST,
 TE_CLASS,
 TE_STRING,
 TE_BUILTIN,
-TE_ALL
+TE_ALL,
+TE_STATS,
+TE_GC,
+TE_COMPACT
 };
 
 /* Must be powers of two; simulated enum */
@@ -171,7 +174,9 @@ typedef struct TTM TTM;
 typedef struct Function Function;
 typedef struct Charclass Charclass;
 typedef struct Property Property;
+typedef struct Atom Atom;
 typedef struct Frame Frame;
+typedef struct Segment Segment;
 typedef struct VArray VArray;
 typedef VArray VList;
 typedef VArray VString;
@@ -179,12 +184,11 @@ typedef VArray VString;
 typedef TTMERR (*TTMFCN)(TTM*, Frame*, VString*);
 
 /**************************************************/
-/* Generic pseudo-hashtable */
+/* Generic hashtable; see hash.h */
 
 /**
-HASHSIZE constraints:
-1. Must be a power of two so that HASHTABLEMASK becomes a sequence of one bits.
-2. Must be <= 256 since it used a single byte to index the top-level of table.
+HASHSIZE is the initial no. of slots in a table;
+it must be a power of two. The table grows as needed.
 */
 
 #ifdef GDB
@@ -193,26 +197,63 @@ HASHSIZE constraints:
 #define HASHSIZE 256
 #endif
 
-#define HASHTABLEMASK ((unsigned)(HASHSIZE-1))
-
 struct HashEntry {
     char* name;
     unsigned hash;
-    struct HashEntry* next;
 };
 
-/* Note that the ith entry is actually only used to provide
-   a place to store the pointer to the first real entry.
-*/
 struct HashTable {
     size_t nentries; /* convenience: track no. of entries in table */
-    struct HashEntry table[HASHSIZE];
+    size_t alloc; /* no. of slots: 0 or a power of two */
+    struct HashEntry** table; /* the slots; NULL => empty slot */
+    struct SkipList* ordered; /* !NULL => entries are also kept in name order; see hashOrder */
+};
+
+/* Ordered index of a HashTable: a skiplist sorted by strcmp of the names */
+struct SkipNode {
+    struct HashEntry* entry;
+    struct SkipNode* next[1]; /* really next[level]; allocated to fit */
+};
+
+struct SkipList {
+    int level; /* no. of levels in use: 1..SKIPMAXLEVEL */
+    unsigned seed; /* state for choosing the level of new nodes */
+    struct SkipNode* head; /* sentinel; has SKIPMAXLEVEL next pointers */
 };
 
 struct HashWalk {
-    int chain;
+    size_t slot; /* next slot to examine */
     struct HashTable* table;
-    struct HashEntry* entry;
+};
+
+/**************************************************/
+/* A compiled substring searcher; see searchcompile in simd.h */
+
+struct Searcher {
+    const char* pattern; /* == copy if cached */
+    size_t plen;
+    unsigned hash; /* computehashn(pattern,plen) */
+    size_t rare; /* offset of the pattern byte least likely to occur in text */
+    size_t other; /* offset of a second byte to filter on; != rare if plen > 1 */
+    unsigned long lastuse; /* searchcache.clock at last use; 0 => entry unused */
+    char copy[SEARCHPATMAX+1];
+};
+
+/**************************************************/
+/* Fixed size object pool; see pool.h */
+
+union PoolSlab { /* header of each slab; the elements follow it */
+    union PoolSlab* next;
+    double align; /* force the strictest common alignment */
+};
+
+struct Pool {
+    size_t elemsize; /* rounded up to a multiple of sizeof(union PoolSlab) */
+    void* freelist; /* free elements, linked through their first word */
+    union PoolSlab* slabs; /* all slabs; released by poolclear */
+    size_t inuse; /* no. of elements handed out and not freed */
+    unsigned long allocs; /* total poolalloc calls */
+    unsigned long nslabs; /* total slabs allocated */
 };
 
 /**************************************************/
@@ -220,11 +261,25 @@ struct HashWalk {
   Define a ttm frame
 */
 
+/* The buffers of a scan suspended while #<catch> runs a nested scan */
+struct Suspended {
+    VString* active;
+    VString* passive;
+    struct Suspended* next;
+};
+
 struct Frame {
-  char* argv[MAXARGS+1]; /* Allow for final NULL arg as signal; not counted in argc */
+  char** argv; /* Allow for final NULL arg as signal; not counted in argc; points into args */
+  size_t* arglen; /* arglen[i] == strlen(argv[i]) */
   size_t argc;
+  size_t argalloc; /* |argv| == |arglen| == argalloc; grows on demand */
+  unsigned namehash; /* computehash(argv[0]); set by collectargs */
   int active; /* 1 => # 0 => ## */
-  VString* result; /* Dual duty: (1) collect each arg in turn and (2) collect function call result */
+  size_t savepassive; /* length of ttm->vs.passive when the call started */
+  size_t argoff; /* start of the arg being collected in ttm->vs.passive; see scan() */
+  VString* args; /* Arena holding the nul terminated arguments; reset (not freed) by popFrame */
+  VString* result; /* Dual duty: (1) collect each arg in turn and (2) collect function call result; kept across calls */
+  Function* locals; /* names defined by #<dl> while this call was pending; freed by popFrame */
 };
 
 /**************************************************/
@@ -285,15 +340,24 @@ struct TTM {
 	utf8cpa lbrc;    /* escaped string bracket open char (==openc) */
 	utf8cpa rbrc;    /* escaped string bracket close char (==closec) */
     } meta;
+    struct Significance { /* Derived from meta; see simd.h */
+	utf8 table[256]; /* SIG_XXX flags for each byte value */
+	utf8 metabytes[8]; /* distinct first bytes of the meta chars */
+	int nmetabytes;
+    } sig;
     struct Buffers {
 	VString* active; /* string being processed */
 	VString* passive; /* already processed part of active */
 	VString* tmp; /* misc text */
 	VString* result; /* staging area before insertion into active or passive */
+	struct Suspended* suspended; /* scans suspended by #<catch>, innermost first */
     } vs;
     struct FrameStack {
 	int top; /* |stack| == (top) */
-	Frame stack[MAXFRAMEDEPTH];
+	int maxtop; /* high water mark for top */
+	size_t alloc; /* no. of slots in stack */
+	Frame** stack; /* grows on demand; frames are never moved */
+	size_t nlocals; /* no. of local names in all frames; 0 => skip the search */
     } frames;
     struct IO {
 	/* stdin, stdout, and stderr are the unix equivalent */
@@ -302,18 +366,58 @@ struct TTM {
 	TTMFILE* _stderr;
 	TTMFILE* allfiles[MAXOPENFILES]; /* vector of all open files */
     } io;
-    /* Following 2 fields are hashtables indexed by low order 7 bits of some character */
+    /* Following fields are hashtables; see hash.h */
     struct Tables {
 	struct HashTable dictionary;
 	struct HashTable charclasses;
 	struct HashTable properties;
+	struct HashTable atoms; /* the unique copy of every name; see intern() */
     } tables;
+    struct Pools { /* Storage for the objects in the tables; see pool.h */
+	struct Pool functions;
+	struct Pool charclasses;
+	struct Pool properties;
+    } pools;
+    struct Builtins { /* Storage for the builtin functions; see defineBuiltinFunctions */
+	size_t count;
+	Function* functions; /* one block holding all the builtin Function objects */
+	Atom* atoms; /* one block holding the atoms for their names */
+    } builtins;
+    struct CallCache { /* Cache of dictionary lookups by exec(); see callcacheLookup */
+	unsigned generation; /* bumped whenever the name => Function mapping changes */
+	struct CallCacheEntry {
+	    unsigned generation; /* entry is stale if != CallCache.generation */
+	    unsigned hash;
+	    Function* fcn;
+	} entries[CALLCACHESIZE];
+	unsigned long hits;
+	unsigned long misses;
+    } callcache;
+    struct SearchCache { /* Compiled #<scn> patterns; see searcherLookup */
+	struct Searcher entries[SEARCHCACHESIZE];
+	struct Searcher uncached; /* for patterns longer than SEARCHPATMAX */
+	unsigned long clock; /* bumped on every lookup; see Searcher.lastuse */
+	unsigned long hits;
+	unsigned long misses;
+    } searchcache;
+    struct Collector { /* See gc.h */
+	size_t threshold; /* next automatic collection when pools.functions.inuse reaches this */
+	unsigned long runs;
+	unsigned long collected; /* total no. of names collected */
+    } gc;
+    struct Compactor { /* See gc.h */
+	size_t countdown; /* calls until the next automatic compaction */
+	unsigned long runs;
+	unsigned long reclaimed; /* total no. of bytes given back */
+    } compact;
     /* TTM Execution Properties; These must be kept consistent with property table entries */
     struct Properties { /* WARN: reflect changes to PropEnum and its uses */
 	size_t stacksize;
 	size_t execcount;
 	size_t showfinal; /* 1=>print contents of passive buffer after scan() finishes; 0=>suppress */
 	size_t showcall; /* 1=>print contents of passive buffer after each function call; 0=>suppress */
+	size_t gclimit; /* >0 => collect created names when there are this many functions; see gc.h */
+	size_t compactinterval; /* >0 => compact memory after this many calls; see gc.h */
     } properties;
 };
 
@@ -347,6 +451,7 @@ cast to a struct HashEntry.
 */
 struct Function {
     struct HashEntry entry;
+    struct Function* nextlocal; /* chain of Frame.locals; see #<dl> */
     struct FcnData { /* structify to simplify re-use under #<ds> */
 	TRACE trace;
 	int locked;
@@ -358,17 +463,40 @@ struct Function {
 	size_t nextsegindex; /* highest segment index number in use in this string */
 	TTMFCN fcn; /* builtin == 1 */
 	VString* body; /* builtin == NULL; body.index is the residual */
+	VArray* segments; /* Segment list for body; NULL => (re)build on next call; see invalidatesegments */
+	VArray* cpindex; /* Byte offsets of every CPINDEXSTEP'th codepoint of body; NULL => (re)build on demand; see buildcpindex */
+	int cpascii; /* cpindex != NULL && body is all ASCII => codepoint and byte offsets are equal */
     } fcn;
 };
 
+/**
+A user-function body pre-parsed by buildsegments()
+into runs of literal text and segment/create marks.
+*/
+struct Segment {
+    size_t segindex; /* index of a segment|create mark or SEGTEXT */
+    size_t offset; /* SEGTEXT => start of the text in the body */
+    size_t length; /* SEGTEXT => length of the text */
+};
+
 /**
 Character Class type
 */
 
+/* A run lo..hi of the non-ASCII codepoints in a class */
+struct CharRange {
+    unsigned lo;
+    unsigned hi;
+};
+
 struct Charclass {
     struct HashEntry entry;
-    char* characters;
+    char* characters; /* as defined; kept for #<ttm;info;class> */
     int negative;
+    /* Compiled form; see compilecharclass */
+    utf8 ascii[16]; /* bit (c>>4) of ascii[c&0xF] set => ASCII c matches, negative folded in */
+    size_t nranges;
+    struct CharRange* ranges; /* sorted and disjoint */
 };
 
 /**
@@ -380,6 +508,18 @@ struct Property {
     char* value;
 };
 
+/**
+Atom type: the unique copy of a name.
+The entries of the other tables share the atom's
+name rather than keeping their own copy.
+*/
+
+struct Atom {
+    struct HashEntry entry; /* entry->name is owned by the atom unless isstatic */
+    int isstatic; /* atom and name are static storage; see internstatic() */
+    size_t refcount; /* no. of entries using the name; unused if isstatic */
+};
+
 /* Current enum of predefined properties */
 enum PropEnum {
 PE_UNDEF=0,
@@ -387,6 +527,8 @@ PE_STACKSIZE,
 PE_EXECCOUNT,
 PE_SHOWFINAL,
 PE_SHOWCALL, /* Show passive output from each function result */
+PE_GCLIMIT, /* Collect created names automatically; see gc.h */
+PE_COMPACTINTERVAL, /* Compact memory automatically; see gc.h */
 };
 
 
@@ -1,3 +1,20 @@
+/**
+Length in bytes of a codepoint indexed by its first byte;
+-1 means the byte cannot start a codepoint.
+Note that SEGMARK0 (0x7F) starts a segment|create mark.
+*/
+#define U8LEN16(n) n,n,n,n,n,n,n,n,n,n,n,n,n,n,n,n
+static const signed char u8lentable[256] = {
+    U8LEN16(1),U8LEN16(1),U8LEN16(1),U8LEN16(1), /* 0x00-0x3F */
+    U8LEN16(1),U8LEN16(1),U8LEN16(1), /* 0x40-0x6F */
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,SEGMARKSIZE, /* 0x70-0x7F */
+    U8LEN16(-1),U8LEN16(-1),U8LEN16(-1),U8LEN16(-1), /* 0x80-0xBF continuation */
+    U8LEN16(2),U8LEN16(2), /* 0xC0-0xDF */
+    U8LEN16(3), /* 0xE0-0xEF */
+    4,4,4,4,4,4,4,4,-1,-1,-1,-1,-1,-1,-1,-1 /* 0xF0-0xFF */
+};
+#undef U8LEN16
+
 /**
 Copy a single codepoint from src to dst
 @param dst target for the codepoint
@@ -15,19 +32,13 @@ memcpycp(char* dst, const char* src)
 static int
 u8sizec(char cc)
 {
-    utf8 c = (utf8)cc;
-    if(c == SEGMARK0) return SEGMARKSIZE; /* segment|create mark */
-    if((c & 0x80) == 0x00) return 1; /* us-ascii */
-    if((c & 0xE0) == 0xC0) return 2;
-    if((c & 0xF0) == 0xE0) return 3;
-    if((c & 0xF8) == 0xF0) return 4;
-    return -1;
+    return (int)u8lentable[(utf8)cc];
 }
 
 static int
 u8size(const char* cp)
 {
-    return u8sizec(*cp);
+    return U8SIZE(cp);
 }
 
 /* return no. bytes in codepoint or -1 if codepoint invalid */
@@ -53,55 +64,35 @@ ascii2u8(char c, char* u8)
     *u8 = (char)(0x7F & (unsigned)c);
 }
 
-static int
-u8equal(const char* c1, const char* c2)
-{
-    int l1 = u8size(c1);
-    int l2 = u8size(c2);
-    if(l1 != l2) return 0;
-    if(memcmp((void*)c1,(void*)c2,l1)!=0) return 0;
-    return 1;
-}
-
 /**
-Compute a pointer to base[n], where base is in units
-of codepoints.	if length of base in codepoints is less than n
-(i.e. we hit EOS), then return ptr to EOS.
-@param base start of the codepoint vector
-@param n offset from base in units of codepoints
-@return pointer to base[n] in units of codepoints or ptr to EOS.
+Convert a UTF-8 codepoint to its numeric value.
+@param cp the codepoint; must be valid and not a segment mark
+@return the value
 */
-static const char*
-u8ithcp(const char* base, size_t n)
+static unsigned
+u8decode(const char* cp)
 {
-    const char* p = NULL;
-    size_t nbytes = strlen((const char*)base); /* bytes as opposed to codepoints */
-    for(p=base;n > 0; n--) {
-	int ncp = u8size(p);
-	if(isnul(p)) {break;} /* hit EOS */
-	if(ncp < 0 || nbytes < (size_t)ncp) return NULL; /* bad codepoint */
-	p += ncp; /* skip across this codepoint */
-	nbytes -= ncp; /* track no. of remaining bytes in src */
+    const utf8* p = UTF8P(cp);
+    switch (u8size(cp)) {
+    case 1: return p[0];
+    case 2: return ((p[0] & 0x1Fu) << 6) | (p[1] & 0x3Fu);
+    case 3: return ((p[0] & 0x0Fu) << 12) | ((p[1] & 0x3Fu) << 6) | (p[2] & 0x3Fu);
+    case 4: return ((p[0] & 0x07u) << 18) | ((p[1] & 0x3Fu) << 12) | ((p[2] & 0x3Fu) << 6) | (p[3] & 0x3Fu);
+    default: break;
     }
-    return p;
+    return 0;
 }
 
-/**
-Compute the position of base[n] in bytes, where base is in units
-of codepoints.	if length of base in codepoints is less than n
-(i.e. we hit EOS), then return position of the EOS.
-@param base start of the codepoint vector
-@param n offset from base in units of codepoints
-@return offset (in bytes) of base[n] from base in units of codepoints or -1 if malformed
-*/
 static int
-u8ith(const char* base, size_t n)
+u8equal(const char* c1, const char* c2)
 {
-    const char* p = u8ithcp(base,n);
-    return (p==NULL?-1:(int)(p - base));
+    int l1 = u8size(c1);
+    int l2 = u8size(c2);
+    if(l1 != l2) return 0;
+    if(memcmp((void*)c1,(void*)c2,l1)!=0) return 0;
+    return 1;
 }
 
-
 /**
 Given a char pointer, backup one codepoint.  This is doable
 because we can recognize the start of a codepoint.
@@ -117,7 +108,7 @@ static const char*
 u8backup(const char* p, const char* base)
 {
     while(p-- > base) {
-        if((UTF8(*p) & 0xB0) != 0xB0) break; /* backup over all continuation bytes */
+        if((UTF8(*p) & 0xC0) != 0x80) break; /* backup over all continuation bytes */
     }
     /* we should be at the start of the codepoint or segmark */
     return p;
@@ -192,16 +183,3 @@ strchr8(const char* s, const char* pattern)
     return p;
 }
 
-/**
-Equivalent of strstr except that the args can be UTF-8.
-@param s string to search
-@param pattern pointer to string to search for.
-@return NULL if not found else ptr to the first found instance of pattern
-*/
-static const char*
-strstr8(const char* s, const char* pattern)
-{
-    const char* p = NULL;
-    p = strstr(s,pattern);
-    return p;
-}
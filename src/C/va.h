@@ -5,12 +5,28 @@ struct VArray {
     size_t length;  /* in units of elemsize */
     char* content; /* use char rather than void to support pointer arithmetic */
     size_t index; /* 0 <= index < length */
-    void* elemnul; /* no arithmetic needed */
+    const void* elemnul; /* no arithmetic needed; see vanulelem */
+    size_t* shared; /* !NULL => content is shared by *shared VArrays; see vashare */
 };
 
 /* VArray has a fixed expansion size */
 #define VARRAYALLOC 64
 
+/* Shared all-zero element used as elemnul for small elements,
+   saving an allocation per VArray */
+#define VANULSIZE 32
+static const char vanulelem[VANULSIZE];
+
+/* Get an elemnul for elements of the given size */
+#define vanewnul(elemsize) ((elemsize) <= VANULSIZE ? (const void*)vanulelem : (const void*)calloc(1,(elemsize)))
+#define vafreenul(va) do{if((va)->elemnul != NULL && (va)->elemnul != (const void*)vanulelem) {free((void*)(va)->elemnul); vastats.frees++;}}while(0)
+
+/* Count the heap operations done here; see #<ttm;stats> */
+static struct VAStats {
+    unsigned long allocs; /* calloc calls */
+    unsigned long frees;  /* free calls */
+} vastats;
+
 /* NUL terminate */
 static void
 nulterm(VArray* va, size_t pos)
@@ -29,6 +45,7 @@ static void vafree(VArray* va);
 static void vafreeall(VArray* va);
 static void vaexpand(VArray* va);
 static void vasetalloc(VArray* va, size_t minalloc);
+static void vatrim(VArray* va, size_t maxalloc);
 static void vasetlength(VArray* va, size_t newlen);
 static void vaappendn(VArray* va, const void* elem, size_t n);
 static void vainsertn(VArray* va, size_t pos, const void* elems, size_t elen);
@@ -39,8 +56,8 @@ static void vaindexset(VArray* va, size_t pos);
 static void* vaindexskip(VArray* va, size_t skip);
 static size_t vaindex(VArray* va);
 static void* vaindexp(VArray* va);
-static void vaindexremoven(VArray* va, size_t elide);
 static void vaindexinsertn(VArray* va, const void* seq, size_t slen);
+static void vaindexprependn(VArray* va, const void* seq, size_t slen);
 static size_t vaelemlen(VArray* va, const void* seq);
 static VArray* vadeepclone(VArray* va, void (deepclone)(void* dstelem, void* srcelem, void* va));
 static VArray* vaclone(VArray* va);
@@ -70,7 +87,9 @@ vanew(size_t elemsize)
     va = (VArray*)calloc(1,sizeof(VArray));
     assert(va != NULL);
     va->elemsize = elemsize;
-    va->elemnul = (void*)calloc(1,elemsize);
+    va->elemnul = vanewnul(elemsize);
+    assert(va->elemnul != NULL);
+    vastats.allocs += (va->elemnul == (const void*)vanulelem ? 1 : 2);
     return va;
 }
 
@@ -113,9 +132,42 @@ static void
 vafree(VArray* va)
 {
     if(va == NULL) return;
-    if(va->content != NULL) free(va->content);
-    if(va->elemnul) free(va->elemnul);
-    free(va);
+    if(va->shared != NULL && --(*va->shared) > 0) {
+	/* content still in use by other sharers */
+    } else {
+	if(va->content != NULL) {free(va->content); vastats.frees++;}
+	if(va->shared != NULL) {free(va->shared); vastats.frees++;}
+    }
+    vafreenul(va);
+    free(va); vastats.frees++;
+}
+
+/**
+Make va the sole owner of its content, copying the content
+if it is shared with other VArrays (see vashare).
+Every operation that modifies the content calls this first.
+@param va
+@return void
+*/
+static void
+vaown(VArray* va)
+{
+    char* copy = NULL;
+
+    if(va->shared == NULL) return;
+    if(*va->shared > 1) {
+	copy = (char*)calloc(va->elemsize,(va->alloc+1));/* always room for nul term */
+	assert(copy != NULL);
+	vastats.allocs++;
+	memcpy(copy,va->content,(va->length*va->elemsize));
+	(*va->shared)--;
+	va->content = copy;
+	nulterm(va,va->length);
+    } else { /* last sharer */
+	free(va->shared);
+	vastats.frees++;
+    }
+    va->shared = NULL;
 }
 
 /**
@@ -130,18 +182,20 @@ vaexpand(VArray* va)
     size_t newalloc;
 
     if(va == NULL) return;
+    vaown(va);
     /* Expand by (alloc == 0 ? 4 : 2 * alloc) */
     newalloc = (va->alloc == 0 ? 4 : (2 * va->alloc));
     /* Calling vaexpand always ensures that va->content is non-null */
     if(va->content != NULL && va->alloc >= newalloc) return; /* space already allocated */
     newcontent = calloc(va->elemsize,(newalloc+1));/* always room for nul term */
     assert(newcontent != NULL);
+    vastats.allocs++;
     if(va->alloc > 0
 	&& va->length > 0
 	&& va->content != NULL) /* something to copy */
             memcpy((void*)newcontent,(void*)va->content,(va->length*va->elemsize));
     nulterm(va,va->length);
-    if(va->content != NULL) free(va->content);
+    if(va->content != NULL) {free(va->content); vastats.frees++;}
     va->content = newcontent;
     va->alloc = newalloc;
     /* length stays the same */  
@@ -159,6 +213,33 @@ vasetalloc(VArray* va, size_t minalloc)
     while(va->alloc < minalloc) vaexpand(va);
 }
 
+/**
+Give back excess capacity: if the array has more than
+maxalloc elements allocated, and its contents fit,
+then shrink the allocation to maxalloc.
+@param va the array to trim
+@param maxalloc the high-water mark
+@return void
+*/
+static void
+vatrim(VArray* va, size_t maxalloc)
+{
+    void* newcontent = NULL;
+
+    if(va == NULL || va->content == NULL) return;
+    if(va->alloc <= maxalloc || va->length > maxalloc) return;
+    vaown(va);
+    newcontent = calloc(va->elemsize,(maxalloc+1));/* always room for nul term */
+    assert(newcontent != NULL);
+    vastats.allocs++;
+    memcpy(newcontent,va->content,(va->length*va->elemsize));
+    free(va->content);
+    vastats.frees++;
+    va->content = newcontent;
+    va->alloc = maxalloc;
+    nulterm(va,va->length);
+}
+
 /**
 Set the length of the current no. of elements in the array.
 @param va the array to expand
@@ -170,6 +251,9 @@ vasetlength(VArray* va, size_t newlen)
 {
     size_t oldlen;
     assert(va != NULL);
+    if(va->shared != NULL && newlen < va->length)
+	va->length = newlen; /* so that vaown copies only what is kept */
+    vaown(va);
     oldlen = va->length;
     if(newlen > oldlen) {
         vasetalloc(va,newlen);
@@ -196,6 +280,7 @@ vaappendn(VArray* va, const void* elem, size_t n)
     size_t need;
     assert(va != NULL && elem != NULL);
     if(n == 0) {n = vaelemlen(va,elem);}
+    vaown(va);
     need = va->length + n;
     vasetalloc(va,need+1);
     assert(va->content != NULL);
@@ -233,6 +318,7 @@ vainsertn(VArray* va, size_t pos, const void* s, size_t slen)
 
     assert(va != NULL && s != NULL);
     if(slen == 0) {slen = vaelemlen(va,s);}
+    vaown(va);
     valen = valength(va);
 #if 0
 initial: |len.........|
@@ -286,6 +372,7 @@ varemoven(VArray* va, size_t pos, size_t elide)
 
     assert(va != NULL);
     if(elide == 0) goto done; /* nothing to move */
+    vaown(va);
     valen = valength(va);
     srcpos = pos + elide;
     if(va->index > pos) {va->index = pos;} else {}
@@ -320,9 +407,11 @@ vaextract(VArray* va)
 {
     void* x = NULL;
     if(va == NULL) return NULL;
+    vaown(va);
     if(va->content == NULL) {
         /* guarantee content existence and nul terminated */
         if((va->content = calloc(va->elemsize,va->elemsize))==NULL) return NULL;
+        vastats.allocs++;
         va->length = 0;
     }
     x = va->content;
@@ -394,33 +483,56 @@ vaindexp(VArray* va)
 }
 
 /**
-Remove a string at the index.
-Index remains unchanged.
+Insert a string at the index.
+Move index past insertion
 @param va
-@param elide number of chars to remove
+@param seq seq of elems to insert
+@param slen |seq| in elemsize units
 @return void
 */
 static void
-vaindexremoven(VArray* va, size_t elide)
+vaindexinsertn(VArray* va, const void* seq, size_t slen)
 {
     if(va->index > va->length) va->index = va->length;
-    varemoven(va,va->index,elide);
+    vainsertn(va,va->index,seq,slen);
+    va->index += slen;
 }
 
 /**
-Insert a string at the index.
-Move index past insertion
+Insert a string just before the index, treating the
+elements in front of the index (already consumed) as a gap.
+If the gap is big enough, the string is copied into it;
+otherwise the unconsumed tail is shifted right leaving a
+gap proportional to the tail so that repeated prepends cost
+amortized O(slen) rather than O(|va|).
+Index is left pointing at the start of the inserted string.
+Warning: elements in front of the index are overwritten.
 @param va
 @param seq seq of elems to insert
 @param slen |seq| in elemsize units
 @return void
 */
 static void
-vaindexinsertn(VArray* va, const void* seq, size_t slen)
+vaindexprependn(VArray* va, const void* seq, size_t slen)
 {
+    size_t tail = 0;
+    size_t gap = 0;
+
+    assert(va != NULL && seq != NULL);
+    if(slen == 0) {slen = vaelemlen(va,seq);}
+    vaown(va);
     if(va->index > va->length) va->index = va->length;
-    vainsertn(va,va->index,seq,slen);
-    va->index += slen;
+    if(slen > va->index) { /* gap too small: move the tail */
+	tail = va->length - va->index;
+	gap = slen + tail;
+	vasetalloc(va,gap+slen+tail+1);
+	memmove((void*)(va->content+((gap+slen)*va->elemsize)),(void*)(va->content+(va->index*va->elemsize)),tail*va->elemsize);
+	va->length = gap+slen+tail;
+	va->index = gap+slen;
+	nulterm(va,va->length); /* guarantee nul term */
+    }
+    va->index -= slen;
+    memcpy((void*)(va->content+(va->index*va->elemsize)),seq,slen*va->elemsize);
 }
 
 /**
@@ -437,6 +549,7 @@ vaindexappendn(VArray* va, const void* elem, size_t nelem)
     size_t need;
     assert(va != NULL && elem != NULL);
     if(nelem == 0) {nelem = vaelemlen(va,elem);}
+    vaown(va);
     need = va->length + nelem;
     vasetalloc(va,need+1);
     assert(va->content != NULL);
@@ -498,14 +611,18 @@ vadeepclone(VArray* va, void (deepclone)(void* dstelem, void* srcelem, void* v))
     VArray* clone = NULL;
     clone = (VArray*)calloc(1,sizeof(VArray));
     assert(va != NULL);
+    vastats.allocs++;
     *clone = *va; /* copy the fields */
     /* Now fix up alloc'd fields */
-    clone->elemnul = (void*)calloc(1,clone->elemsize);
+    clone->shared = NULL;
+    clone->elemnul = vanewnul(clone->elemsize);
     assert(clone->elemnul != NULL);
+    if(clone->elemnul != (const void*)vanulelem) vastats.allocs++;
     if(clone->content != NULL) {
         size_t i;
-        clone->content = (void*)calloc(clone->elemsize,clone->alloc);
+        clone->content = (void*)calloc(clone->elemsize,clone->alloc+1);/* always room for nul term */
         assert(clone->content != NULL);
+        vastats.allocs++;
         for(i=0;i<clone->length;i++) {
             size_t offset = i*clone->elemsize;
             deepclone(clone->content+offset,va->content+offset,(void*)va);
@@ -525,6 +642,37 @@ vaclone(VArray* va)
     return vadeepclone(va,shallowclone);
 }
 
+/**
+Copy-on-write clone of a VArray object: the clone shares
+the content of va, which is only copied when either of
+them is modified (see vaown). The clone has its own index.
+@param va the variable-length object to clone
+@return ptr to clone
+*/
+static VArray*
+vashare(VArray* va)
+{
+    VArray* clone = NULL;
+
+    assert(va != NULL);
+    if(va->content == NULL) return vaclone(va); /* nothing to share */
+    if(va->shared == NULL) {
+	va->shared = (size_t*)malloc(sizeof(size_t));
+	assert(va->shared != NULL);
+	vastats.allocs++;
+	*va->shared = 1;
+    }
+    clone = (VArray*)calloc(1,sizeof(VArray));
+    assert(clone != NULL);
+    vastats.allocs++;
+    *clone = *va; /* copy the fields */
+    clone->elemnul = vanewnul(clone->elemsize);
+    assert(clone->elemnul != NULL);
+    if(clone->elemnul != (const void*)vanulelem) vastats.allocs++;
+    (*va->shared)++;
+    return clone;
+}
+
 /**************************************************/
 /* List (Array of void*) implementation */
 
@@ -553,6 +701,7 @@ static void vlappend(VList* vl, const void* elem) {vaappend((VArray*)vl,(void**)
 static VString* vsnew(void) {return (VString*)vanew(sizeof(char));}
 static void vsfree(VString* vs) {vafree((VArray*)vs);}
 static void vssetalloc(VString* vs, size_t minalloc) {vasetalloc((VArray*)vs,minalloc);}
+static void vstrim(VString* vs, size_t maxalloc) {vatrim((VArray*)vs,maxalloc);}
 static void vssetlength(VString* vs, size_t newlen) {vasetlength((VArray*)vs,newlen);}
 static void vsappendn(VString* vs, const char* elem, size_t n) {vaappendn((VArray*)vs,(void*)elem,n);}
 static void vsappend(VString* vs, char elem) {vaappend((VArray*)vs,(void*)&elem);}
@@ -561,12 +710,14 @@ static void vsremoven(VString* vs, size_t pos, size_t elide) {varemoven((VArray*
 static char* vsextract(VString* vs) {return (char*)vaextract((VArray*)vs);}
 static char* vsgetp(VString* vs, size_t pos) {return (char*)vagetp((VArray*)vs,pos);}
 static VString* vsclone(VString* vs) {return (VString*)vaclone((VArray*)vs);}
+static VString* vsshare(VString* vs) {return (VString*)vashare((VArray*)vs);}
 static void vsindexset(VString* vs, size_t pos) {vaindexset((VArray*)vs,pos);}
 static char* vsindexskip(VString* vs, size_t skip) {return (char*)vaindexskip((VArray*)vs,skip);}
 static size_t vsindex(VString* vs) {return vaindex((VArray*)vs);}
 static char* vsindexp(VString* vs) {return (char*)vaindexp((VArray*)vs);}
 static void vsindexinsertn(VString* vs, const void* seq, size_t slen) {vaindexinsertn((VArray*)vs,seq,slen);}
 static void vsindexappendn(VString* vs, const char* elem, size_t n) {vaindexappendn((VArray*)vs,(void*)elem,n);}
+static void vsindexprependn(VString* vs, const char* seq, size_t slen) {vaindexprependn((VArray*)vs,(void*)seq,slen);}
 
 /*************************/
 /* "Inlined" */
@@ -593,4 +744,6 @@ vasuppresswarnings(void)
     ignore = (void*)vssetalloc;
     ignore = (void*)vsindexinsertn;
     ignore = (void*)vsextract;
+    ignore = (void*)vsremoven;
+    ignore = (void*)vsclone;
 }